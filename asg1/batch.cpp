@@ -0,0 +1,155 @@
+// $Id: batch.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "../common/tokenize.h"
+#include "batch.h"
+#include "debug.h"
+
+batch_script::batch_script (const string& filename,
+                            commands& cmdmap): cmdmap (cmdmap)
+{
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0)
+      throw yshell_exn (filename + ": " + strerror (errno));
+   struct stat info;
+   if (fstat (fd, &info) < 0)
+   {
+      close (fd);
+      throw yshell_exn (filename + ": " + strerror (errno));
+   }
+   if (not S_ISREG (info.st_mode))
+   {
+      // A pipe can't be mapped, so read it all in instead.
+      char chunk[1 << 16];
+      ssize_t count;
+      while ((count = read (fd, chunk, sizeof chunk)) > 0)
+         unmapped.append (chunk, count);
+      int error = errno;
+      close (fd);
+      if (count < 0)
+         throw yshell_exn (filename + ": " + strerror (error));
+      base = unmapped.data();
+      length = unmapped.size();
+   }
+   else
+   {
+      length = info.st_size;
+      void* addr = length == 0 ? nullptr
+                 : mmap (nullptr, length, PROT_READ, MAP_PRIVATE,
+                         fd, 0);
+      int error = errno;
+      close (fd);
+      if (addr == MAP_FAILED)
+         throw yshell_exn (filename + ": " + strerror (error));
+      base = static_cast<const char*> (addr);
+      if (length > 0) madvise (addr, length, MADV_SEQUENTIAL);
+   }
+   try {
+      split_lines();
+   }catch (...) {
+      if (mapped()) munmap (const_cast<char*> (base), length);
+      throw;
+   }
+   DEBUGF ('f', filename << ": " << lines.size() << " lines, "
+           << words.size() << " words");
+}
+
+batch_script::~batch_script()
+{
+   if (mapped()) munmap (const_cast<char*> (base), length);
+}
+
+// Splits on blanks and tabs, like split (line, " \t").  Blank
+// lines and comments get no words and no function.
+void batch_script::split_lines()
+{
+   const char* end = base + length;
+   const delimiter_set blanks (" \t");
+   string name;
+   for (const char* line = base; line < end; )
+   {
+      const char* newline = static_cast<const char*>
+                            (memchr (line, '\n', end - line));
+      const char* line_end = newline == nullptr ? end : newline;
+      if (line_end - line > UINT32_MAX)
+         throw yshell_exn ("script: line too long");
+      line_t entry {uint64_t (line - base), uint32_t (line_end - line),
+                    0, words.size(), nullptr};
+      tokenizer tokens (line, line_end, blanks);
+      for (token word; tokens.next (word); )
+      {
+         words.push_back (word_t {uint32_t (word.data - line),
+                                  uint32_t (word.size)});
+         ++entry.word_count;
+      }
+      if (entry.word_count > 0
+          and line[words[entry.first_word].offset] == '#')
+      {
+         words.resize (entry.first_word);
+         entry.word_count = 0;
+      }
+      if (entry.word_count > 0)
+      {
+         const word_t& first = words[entry.first_word];
+         name.assign (line + first.offset, first.length);
+         entry.fn = cmdmap.find (name);
+      }
+      lines.push_back (entry);
+      line = line_end + 1;
+   }
+}
+
+void batch_script::run (inode_state& state)
+{
+   auto start = chrono::steady_clock::now();
+   size_t done = 0;
+   auto report = [&]() {
+      chrono::duration<double> elapsed = chrono::steady_clock::now()
+                                       - start;
+      DEBUGF ('f', done << " lines in " << elapsed.count() << "s, "
+              << done / elapsed.count() << " lines/sec");
+   };
+   batch_output buffered;
+   wordvec argv;
+   try {
+      for (const line_t& line: lines)
+      {
+         ++done;
+         const char* text = base + line.offset;
+         cout << state.get_prompt();
+         cout.write (text, line.length);
+         cout << '\n';
+         if (line.word_count == 0) continue;
+         try {
+            argv.resize (line.word_count);
+            for (size_t nr = 0; nr < line.word_count; ++nr)
+            {
+               const word_t& word = words[line.first_word + nr];
+               argv[nr].assign (text + word.offset, word.length);
+            }
+            DEBUGF ('y', "words = " << argv);
+            run_command (state, cmdmap, argv, line.fn);
+         }catch (yshell_exn& exn) {
+            complain() << exn.what() << endl;
+         }
+      }
+   }catch (...) {
+      report();
+      throw;
+   }
+   cout << state.get_prompt() << "^D" << endl;
+   DEBUGF ('y', "EOF");
+   report();
+}
+
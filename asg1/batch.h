@@ -0,0 +1,68 @@
+// $Id: batch.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "inode.h"
+
+//
+// batch_script -
+//    A script run with -f.  The file is mapped into memory and
+//    split in one pass into a table of lines, each with its words
+//    located and its command already looked up, so running it
+//    does no reading, splitting, or map lookups per line.
+//    The output is what "yshell <script" would print, except that
+//    a last line with no newline is run rather than dropped.
+//
+// ctor -
+//    Maps and splits the file, or reads it if it is a pipe.
+//    Throws yshell_exn if it can't.
+// run -
+//    Runs each line in turn, with cout buffered.  Errors are
+//    reported and the next line run, as in the interactive loop.
+//    Lets ysh_exit_exn through.  Flag 'f' reports lines/sec.
+//
+
+class batch_script {
+   private:
+      batch_script (const batch_script&) = delete;
+      batch_script& operator= (const batch_script&) = delete;
+      // Words are located relative to the start of their line.
+      struct word_t {
+         uint32_t offset;
+         uint32_t length;
+      };
+      struct line_t {
+         uint64_t offset;
+         uint32_t length;
+         uint32_t word_count;
+         size_t first_word;
+         function fn;
+      };
+      commands& cmdmap;
+      const char* base {nullptr};
+      size_t length {0};
+      string unmapped;
+      bool mapped() const {
+         return base != nullptr and base != unmapped.data();
+      }
+      vector<line_t> lines;
+      vector<word_t> words;
+      void split_lines();
+   public:
+      batch_script (const string& filename, commands& cmdmap);
+      ~batch_script();
+      size_t size() const { return lines.size(); }
+      void run (inode_state& state);
+};
+
+#endif
+
@@ -0,0 +1,44 @@
+// $Id: blob.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <functional>
+#include <iostream>
+#include <utility>
+
+using namespace std;
+
+#include "blob.h"
+#include "debug.h"
+#include "pool.h"
+
+unordered_set<blob*, blob_store::blob_hash, blob_store::blob_equal>&
+blob_store::blobs()
+{
+   static unordered_set<blob*, blob_hash, blob_equal> all;
+   return all;
+}
+
+blob* blob_store::intern (string&& bytes)
+{
+   blob probe {move (bytes), 0, 0};
+   probe.hash = std::hash<string>() (probe.bytes);
+   auto found = blobs().find (&probe);
+   if (found != blobs().end())
+   {
+      DEBUGF ('b', "shared " << probe.bytes.size() << " bytes");
+      return share (*found);
+   }
+   blob* created = pool_new<blob> (blob {move (probe.bytes),
+                                         probe.hash, 1});
+   blobs().insert (created);
+   DEBUGF ('b', "new blob of " << created->bytes.size() << " bytes");
+   return created;
+}
+
+void blob_store::release (blob* shared)
+{
+   if (--shared->refs > 0) return;
+   blobs().erase (shared);
+   pool_delete (shared);
+}
+
@@ -0,0 +1,59 @@
+// $Id: blob.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __BLOB_H__
+#define __BLOB_H__
+
+#include <string>
+#include <unordered_set>
+
+using namespace std;
+
+//
+// blob -
+//    The contents of a file, shared by every file whose contents
+//    are the same.  A blob never changes:  writing to a file gives
+//    it a different blob.  refs counts the files using it.
+//
+// blob_store -
+//    Finds blobs by their contents, so that equal contents are
+//    stored only once, whether two files got them by cp, by
+//    writing the same words, or from an image.
+// intern -
+//    Returns the blob holding bytes, with one more reference.
+//    Takes the bytes over if there is no such blob yet.
+// share -
+//    Adds a reference to a blob, in constant time.
+// release -
+//    Drops a reference, freeing the blob when none are left.
+//
+
+struct blob {
+   string bytes;
+   size_t hash;
+   size_t refs;
+};
+
+class blob_store {
+   private:
+      struct blob_hash {
+         size_t operator() (const blob* b) const { return b->hash; }
+      };
+      struct blob_equal {
+         bool operator() (const blob* left, const blob* right) const {
+            return left->hash == right->hash
+               and left->bytes == right->bytes;
+         }
+      };
+      static unordered_set<blob*, blob_hash, blob_equal>& blobs();
+   public:
+      static blob* intern (string&& bytes);
+      static blob* share (blob* shared) {
+         ++shared->refs;
+         return shared;
+      }
+      static void release (blob* shared);
+};
+
+#endif
+
@@ -1,24 +1,44 @@
 // $Id: commands.cpp,v 1.10 2014-04-09 17:04:58-07 - - $
 // Author: Coy Humphrey (cmhumphr)
 
-#include <iomanip>
+#include <memory>
 
 #include "commands.h"
 #include "debug.h"
+#include "glob.h"
+#include "history.h"
+#include "hosttree.h"
+#include "journal.h"
+#include "stats.h"
+#include "walk.h"
 
 commands::commands(): map ({
    {"cat"   , fn_cat   },
    {"cd"    , fn_cd    },
+   {"cp"    , fn_cp    },
+   {"du"    , fn_du    },
    {"echo"  , fn_echo  },
    {"exit"  , fn_exit  },
+   {"export", fn_export},
+   {"find"  , fn_find  },
+   {"import", fn_import},
+   {"ln"    , fn_ln    },
+   {"load"  , fn_load  },
    {"ls"    , fn_ls    },
    {"lsr"   , fn_lsr   },
    {"make"  , fn_make  },
    {"mkdir" , fn_mkdir },
    {"prompt", fn_prompt},
    {"pwd"   , fn_pwd   },
+   {"quota" , fn_quota },
+   {"redo"  , fn_redo  },
    {"rm"    , fn_rm    },
-   {"rmr"   , fn_rmr   }
+   {"rmr"   , fn_rmr   },
+   {"rollback", fn_rollback},
+   {"save"  , fn_save  },
+   {"snapshot", fn_snapshot},
+   {"stats" , fn_stats },
+   {"undo"  , fn_undo  }
 }){}
 
 function commands::at (const string& cmd) {
@@ -32,21 +52,54 @@ function commands::at (const string& cmd) {
    return result->second;
 }
 
-void pwd_recursive (inode_state& state, inode *cwd, string &result)
+function commands::find (const string& cmd) const {
+   commandmap::const_iterator result = map.find (cmd);
+   return result == map.end() ? nullptr : result->second;
+}
+
+bool commands::reads_only (const string& cmd) const {
+   static const set<string> readers {
+      "cat", "cd", "du", "echo", "exit", "find", "ls", "lsr",
+      "prompt", "pwd", "stats",
+   };
+   return readers.count (cmd) > 0;
+}
+
+void run_command (inode_state& state, commands& cmdmap,
+                  const wordvec& words, function fn)
 {
-   if (cwd != state.get_root())
-   {
-      inode *parent = (*cwd).get_parent();
-      pwd_recursive (state, parent, result);
-      result += "/" + (*cwd).get_name();
+   if (fn == nullptr) fn = cmdmap.at (words.at(0));
+   // Readers leave the history alone:  in server mode they run
+   // alongside each other under a shared lock.
+   bool writing = not cmdmap.reads_only (words.at(0));
+   if (writing) state.history().begin_command();
+   command_stats::timer timing (words.at(0));
+   try {
+      fn (state, words);
+   }catch (...) {
+      if (writing) state.history().abort_command();
+      throw;
    }
+   if (writing) state.history().end_command();
+   journal::record (state, words);
 }
 
+
 
-void fn_cat (inode_state& state, const wordvec& words){
+// Pads text on the left to width, like setw.
+static void append_padded (string& line, const string& text,
+                           size_t width)
+{
+   if (text.size() < width) line.append (width - text.size(), ' ');
+   line += text;
+}
+
+void fn_cat (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    
+   outbuf out (state.output());
    for (size_t ind = 1; ind < words.size(); ++ind)
    {
       inode *file = state.inode_from_path (words[ind]);
@@ -58,11 +111,12 @@ void fn_cat (inode_state& state, const wordvec& words){
       if ((*file).get_type() != FILE_INODE)
          throw yshell_exn ("cat: " + words[ind] + ": Not a file");
          
-      cout << (*file).readfile() << endl;
+      out << (*file).readfile() << '\n';
    }
 }
 
-void fn_cd (inode_state& state, const wordvec& words){
+void fn_cd (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if (words.size() > 2)
@@ -81,17 +135,166 @@ void fn_cd (inode_state& state, const wordvec& words){
    state.set_cwd (ncwd);
 }
 
+// The last name in a path.  A file's own name won't do for
+// output, since a file with several links has several names.
+static string last_component (const string& path)
+{
+   wordvec names = split (path, "/");
+   return names.empty() ? "/" : names.back();
+}
+
+//
+// place_of -
+//    Where ln or cp puts source when told to put it at dest:  in
+//    dest if that is a directory, otherwise at dest itself.  Sets
+//    name and existing to the name it gets and whatever already
+//    has that name, and returns the directory.
+//
+static inode* place_of (inode_state& state, const string& cmd,
+                        const string& source, const string& dest,
+                        string& name, inode*& existing)
+{
+   inode* dir = state.inode_from_path (dest);
+   if (dir != nullptr and dir->get_type() == DIR_INODE)
+   {
+      name = last_component (source);
+      if (name == "/")
+         throw yshell_exn (cmd + ": " + source + ": Is the root");
+   }
+   else
+   {
+      name = last_component (dest);
+      string dir_path = dest.substr (0, dest.rfind (name));
+      dir = dir_path.empty() ? state.get_cwd()
+                             : state.inode_from_path (dir_path);
+      if (dir == nullptr or dir->get_type() != DIR_INODE)
+         throw yshell_exn (cmd + ": " + dest + 
+                           ": Parent directory does not exist");
+   }
+   if (name == "." or name == ".." or name == "/")
+      throw yshell_exn (cmd + ": " + dest + ": Invalid name");
+   const directory& dirents = dir->get_dirents();
+   auto found = dirents.find (name);
+   existing = found == dirents.end() ? nullptr : found->second;
+   return dir;
+}
+
+// Copies the directory from to a new directory name in into, one
+// directory at a time.  Files share their contents with the
+// originals, so this costs the same however big they are.
+static void copy_tree (inode* from, inode* into, const string& name)
+{
+   vector<pair<inode*, inode*>> pending {
+      make_pair (from, &into->mkdir (name))
+   };
+   while (not pending.empty())
+   {
+      inode* source = pending.back().first;
+      inode* copy = pending.back().second;
+      pending.pop_back();
+      for (const auto& dirent: source->get_dirents())
+      {
+         if (dirent.first == "." || dirent.first == "..") continue;
+         if (dirent.second->get_type() == DIR_INODE)
+         {
+            pending.push_back (make_pair (dirent.second,
+                                          &copy->mkdir (dirent.first)));
+         }
+         else
+         {
+            copy->mkfile (dirent.first).share_contents (*dirent.second);
+         }
+      }
+   }
+}
+
+void fn_cp (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 3)
+      throw yshell_exn ("cp: Invalid arguments");
+   inode *source = state.inode_from_path (words[1]);
+   if (source == nullptr)
+      throw yshell_exn ("cp: " + words[1] + 
+                        ": No such file or directory");
+   string name;
+   inode *existing {nullptr};
+   inode *dir = place_of (state, "cp", words[1], words[2], name,
+                          existing);
+   
+   if (source->get_type() == FILE_INODE)
+   {
+      if (existing == nullptr)
+      {
+         dir->check_quota (source->size(), 1);
+         dir->mkfile (name).share_contents (*source);
+      }
+      else if (existing->get_type() == FILE_INODE)
+         existing->share_contents (*source);
+      else
+         throw yshell_exn ("cp: " + words[2] + ": Is a directory");
+      return;
+   }
+   
+   if (existing != nullptr)
+      throw yshell_exn ("cp: " + name + ": File exists");
+   for (inode *up = dir; ; up = up->get_parent())
+   {
+      if (up == source)
+         throw yshell_exn ("cp: " + words[1] + 
+                           ": Can't copy a directory into itself");
+      if (up == state.get_root()) break;
+   }
+   // The copy comes to the same totals as the original, so if it
+   // fits at all it fits all the way.
+   dir->check_quota (source->total_bytes(), source->total_inodes());
+   copy_tree (source, dir, name);
+}
+
+// Totals as du shows them:  bytes, inodes and the path.
+static void du_line (outbuf& out, inode *node, const string& path)
+{
+   string line;
+   append_padded (line, to_string (node->total_bytes()), 10);
+   line += "  ";
+   append_padded (line, to_string (node->total_inodes()), 8);
+   line += "  ";
+   line += path;
+   line += '\n';
+   out << line;
+}
+
+void fn_du (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   outbuf out (state.output());
+   if (words.size() == 1)
+      du_line (out, state.get_cwd(), state.get_cwd_path());
+   for (size_t ind = 1; ind < words.size(); ++ind)
+   {
+      inode *node = state.inode_from_path (words[ind]);
+      if (node == nullptr)
+         throw yshell_exn ("du: " + words[ind] + 
+                           ": No such file or directory");
+      du_line (out, node, words[ind]);
+   }
+}
+
 void fn_echo (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    bool want_space = false;
     // Ignore function name
    for (size_t index = 1; index < words.size(); ++index) {
-      if (want_space) cout << " ";
+      if (want_space) state.output() << " ";
       else want_space = true;
-      cout << words[index];
+      state.output() << words[index];
    }
-   cout << endl;
+   state.output() << endl;
 }
 
 void fn_exit (inode_state& state, const wordvec& words){
@@ -119,29 +322,288 @@ void fn_exit (inode_state& state, const wordvec& words){
    throw ysh_exit_exn();
 }
 
-void fn_ls (inode_state& state, const wordvec& words){
+//
+// find_options -
+//    The tests find makes of each node;  a node is listed if it
+//    passes all of them.  size is compared with what ls shows:
+//    bytes for a file, entries for a directory.
+//
+struct find_options {
+   unique_ptr<glob> name;
+   int type {0};
+   int size_sign {0};
+   long size {-1};
+   bool accepts (inode* node, const string& node_name) const {
+      if (type == 'f' and node->get_type() != FILE_INODE) return false;
+      if (type == 'd' and node->get_type() != DIR_INODE) return false;
+      if (size >= 0)
+      {
+         long node_size = node->size();
+         if (size_sign > 0 and node_size <= size) return false;
+         if (size_sign < 0 and node_size >= size) return false;
+         if (size_sign == 0 and node_size != size) return false;
+      }
+      return name == nullptr or name->matches (node_name);
+   }
+};
+
+static find_options parse_find (const wordvec& words, size_t first)
+{
+   static const set<string> known {"-name", "-size", "-type"};
+   find_options options;
+   for (size_t ind = first; ind < words.size(); ind += 2)
+   {
+      if (known.count (words[ind]) == 0)
+         throw yshell_exn ("find: " + words[ind] + ": Unknown option");
+      if (ind + 1 == words.size())
+         throw yshell_exn ("find: " + words[ind] + 
+                           ": Missing argument");
+      const string& arg = words[ind + 1];
+      if (words[ind] == "-name")
+      {
+         options.name.reset (new glob (arg));
+      }
+      else if (words[ind] == "-type")
+      {
+         if (arg != "f" and arg != "d")
+            throw yshell_exn ("find: -type " + arg + ": Not f or d");
+         options.type = arg[0];
+      }
+      else
+      {
+         size_t digits = arg[0] == '+' or arg[0] == '-' ? 1 : 0;
+         if (digits == 1) options.size_sign = arg[0] == '+' ? 1 : -1;
+         size_t idx {};
+         try {options.size = stol (arg.substr (digits), &idx);}
+         catch (exception&) {idx = 0;}
+         if (idx == 0 or digits + idx != arg.size()
+             or options.size < 0)
+            throw yshell_exn ("find: -size " + arg + ": Invalid size");
+      }
+   }
+   return options;
+}
+
+//
+// find_under -
+//    Lists the nodes under top that pass options, in the order lsr
+//    would visit them.  Directories are walked with a stack of
+//    iterators into their own entries, and the path of each node
+//    is kept in one buffer that grows and shrinks with the stack,
+//    so nothing is copied on the way.
+//
+static void find_under (inode* top, const string& top_path,
+                        const find_options& options, outbuf& out)
+{
+   struct frame {
+      directory::const_iterator next, end;
+      size_t path_length;
+   };
+   string path = top_path;
+   if (path.empty() or path.back() != '/') path += '/';
+   vector<frame> stack;
+   const directory& top_dirents = top->get_dirents();
+   stack.push_back ({top_dirents.begin(), top_dirents.end(),
+                     path.size()});
+   while (not stack.empty())
+   {
+      frame& dir = stack.back();
+      if (dir.next == dir.end)
+      {
+         stack.pop_back();
+         continue;
+      }
+      const string& name = dir.next->first;
+      inode* node = dir.next->second;
+      ++dir.next;
+      if (name == "." or name == "..") continue;
+      path.resize (dir.path_length);
+      path += name;
+      if (options.accepts (node, name))
+      {
+         out << path;
+         out << '\n';
+      }
+      if (node->get_type() == DIR_INODE)
+      {
+         path += '/';
+         const directory& dirents = node->get_dirents();
+         stack.push_back ({dirents.begin(), dirents.end(),
+                           path.size()});
+      }
+   }
+}
+
+// export [-m] path hostpath
+void fn_export (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    
-   if (words.size() == 1)
+   bool metadata_only = words.size() == 4 and words[1] == "-m";
+   size_t first = metadata_only ? 2 : 1;
+   if (words.size() != first + 2)
+      throw yshell_exn ("export: Invalid arguments");
+   const string& path = words[first];
+   const string& host_path = words[first + 1];
+   inode *top = state.inode_from_path (path);
+   if (top == nullptr)
+      throw yshell_exn ("export: " + path + 
+                        ": No such file or directory");
+   if (top->get_type() != DIR_INODE)
+      throw yshell_exn ("export: " + path + ": Not a directory");
+   try {
+      export_tree (*top, host_path, metadata_only);
+   }catch (yshell_exn& exn) {
+      throw yshell_exn (string ("export: ") + exn.what());
+   }
+}
+
+// Only the paths are expanded;  a -name pattern is find's own.
+void fn_find (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   size_t first_option = 1;
+   while (first_option < words.size()
+          and words[first_option][0] != '-')
+      ++first_option;
+   find_options options = parse_find (words, first_option);
+   wordvec starts = expand_globs (state,
+         wordvec (words.begin(), words.begin() + first_option));
+   starts.erase (starts.begin());
+   if (starts.empty()) starts.push_back (".");
+   
+   outbuf out (state.output());
+   for (const auto& start: starts)
    {
-      inode *cwd = state.get_cwd();
-      directory dir = (*cwd).get_dirents();
-      string result = "";
-      pwd_recursive (state, cwd, result);
-      if (cwd == state.get_root()) result = "/";
-      cout << result << ":" << endl;
-      for (auto it = dir.cbegin(); it != dir.cend(); ++it)
+      inode *top = state.inode_from_path (start);
+      if (top == nullptr)
+         throw yshell_exn ("find: " + start + 
+                           ": No such file or directory");
+      if (options.accepts (top, last_component (start)))
       {
-         int size = it->second->size();
-         int nr   = it->second->get_inode_nr();
-         string name = it->first;
-         if (name != "." && name != "..")
-            if (it->second->get_type() == DIR_INODE)
-               name += "/";
-         cout << setw (6) << nr << "  " << setw (6) << size << 
-                  "  " << setw (6) << name << endl;
+         out << start;
+         out << '\n';
       }
+      if (top->get_type() == DIR_INODE)
+         find_under (top, start, options, out);
+   }
+}
+
+// import [-m] hostpath path
+void fn_import (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   bool metadata_only = words.size() == 4 and words[1] == "-m";
+   size_t first = metadata_only ? 2 : 1;
+   if (words.size() != first + 2)
+      throw yshell_exn ("import: Invalid arguments");
+   const string& host_path = words[first];
+   const string& path = words[first + 1];
+   string name;
+   inode *existing {nullptr};
+   inode *dir = place_of (state, "import", host_path, path, name,
+                          existing);
+   if (existing != nullptr)
+      throw yshell_exn ("import: " + name + ": File exists");
+   string skipped;
+   try {
+      skipped = import_tree (host_path, *dir, name, metadata_only);
+   }catch (yshell_exn& exn) {
+      throw yshell_exn (string ("import: ") + exn.what());
+   }
+   // The rest did go in, so this is not an error.
+   if (not skipped.empty()) complain() << "import: " << skipped << endl;
+}
+
+void fn_ln (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 3)
+      throw yshell_exn ("ln: Invalid arguments");
+   inode *target = state.inode_from_path (words[1]);
+   if (target == nullptr)
+      throw yshell_exn ("ln: " + words[1] + 
+                        ": No such file or directory");
+   if (target->get_type() != FILE_INODE)
+      throw yshell_exn ("ln: " + words[1] + 
+                        ": Can't link a directory");
+   string name;
+   inode *existing {nullptr};
+   inode *dir = place_of (state, "ln", words[1], words[2], name,
+                          existing);
+   if (existing != nullptr)
+      throw yshell_exn ("ln: " + name + ": File exists");
+   dir->link (name, *target);
+}
+
+void fn_load (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 2)
+      throw yshell_exn ("load: Invalid arguments");
+   try {
+      state.load (words[1]);
+   }catch (yshell_exn& exn) {
+      throw yshell_exn (string ("load: ") + exn.what());
+   }
+}
+
+// One line of ls:  inode number, size and name.
+static void ls_line (string& out, inode *node, const string& name)
+{
+   append_padded (out, to_string (node->get_inode_nr()), 6);
+   out += "  ";
+   append_padded (out, to_string (node->size()), 6);
+   out += "  ";
+   append_padded (out, name, 6);
+   out += '\n';
+}
+
+static void ls_line (outbuf& out, inode *node, const string& name)
+{
+   string line;
+   ls_line (line, node, name);
+   out << line;
+}
+
+// Lists the entries of dir under the heading "header:".
+static void ls_dir (string& out, inode *dir, const string& header)
+{
+   out += header;
+   out += ":\n";
+   for (const auto& dirent: dir->get_dirents())
+   {
+      const string& name = dirent.first;
+      inode *node = dirent.second;
+      if (name != "." && name != ".." && node->get_type() == DIR_INODE)
+         ls_line (out, node, name + "/");
+      else
+         ls_line (out, node, name);
+   }
+}
+
+static void ls_dir (outbuf& out, inode *dir, const string& header)
+{
+   string text;
+   ls_dir (text, dir, header);
+   out << text;
+}
+
+void fn_ls (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   outbuf out (state.output());
+   if (words.size() == 1)
+   {
+      inode *cwd = state.get_cwd();
+      ls_dir (out, cwd, state.get_cwd_path());
    }
    
    else
@@ -153,44 +615,25 @@ void fn_ls (inode_state& state, const wordvec& words){
             throw yshell_exn ("ls: " + words[ind] + 
                               ": No such file or directory");
          if (curr->get_type() == FILE_INODE)
-         {
-            int size = curr->size();
-            int nr   = curr->get_inode_nr();
-            string name = curr->get_name();
-            cout << setw (6) << nr << "  " << setw (6) << size << 
-                     "  " << setw (6) << name << endl;
-         }
+            ls_line (out, curr, last_component (words[ind]));
          else
-         {
-            directory dir = curr->get_dirents();
-            cout << words[ind] << ":" << endl;
-            for (auto it = dir.cbegin(); it != dir.cend(); ++it)
-            {
-               int size = it->second->size();
-               int nr   = it->second->get_inode_nr();
-               string name = it->first;
-               if (name != "." && name != "..")
-                  if (it->second->get_type() == DIR_INODE)
-                     name += "/";
-               cout << setw (6) << nr << "  " << setw (6) << size << 
-                        "  " << setw (6) << name << endl;
-            }
-         }
-         
+            ls_dir (out, curr, words[ind]);
       }
    }
 }
 
-void fn_lsr (inode_state& state, const wordvec& words){
+void fn_lsr (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    
+   outbuf out (state.output());
    inode *cd {nullptr};
    
    if (words.size() == 1)
    {
       cd = state.get_cwd();
-      ls_recursive (state, cd);
+      ls_recursive (cd, out);
    }
    else
    {                   
@@ -201,39 +644,54 @@ void fn_lsr (inode_state& state, const wordvec& words){
             throw yshell_exn ("lsr: " + words[ind] + 
                               ": No such file or directory");
          if (cd->get_type() != DIR_INODE)
-         {
-            wordvec ls_words {"", words[ind]};
-            fn_ls (state, ls_words);
-         }
+            ls_line (out, cd, last_component (words[ind]));
          else
-            ls_recursive (state, cd);
+            ls_recursive (cd, out);
       }
    }
    
 }
 
-void ls_recursive (inode_state& state, inode *cd)
+//
+// ls_recursive -
+//    Finds the directories first, then formats them a window at a
+//    time, in parallel when there are enough of them, and writes
+//    each window out in order.
+//
+void ls_recursive (inode *cd, outbuf& out)
 {
    if (cd->get_type() != DIR_INODE)
       throw yshell_exn ("lsr: ls_recursive error");
       
-   string result = "";
-   pwd_recursive (state, cd, result);
-   if (cd == state.get_root()) result = "/";
-   
-   wordvec ls_wordvec{"", result};
-   fn_ls (state, ls_wordvec);
-   
-   directory dir = cd->get_dirents();
-   for (auto it : dir)
+   vector<inode*> dirs = dir_preorder (cd);
+   const size_t window = 4096;
+   vector<string> texts;
+   for (size_t first = 0; first < dirs.size(); first += window)
    {
-      if (it.first == "." || it.first == "..") continue;
-      if (it.second->get_type() == FILE_INODE) continue;
-      ls_recursive (state, it.second);
+      size_t count = min (window, dirs.size() - first);
+      texts.assign (count, string());
+      parallel_for (count, [&] (size_t index) {
+         inode *dir = dirs[first + index];
+         ls_dir (texts[index], dir, dir->get_path());
+      });
+      for (const auto& text: texts) out << text;
    }
 }
 
-
+
+
+// Joins words[2..], separated by spaces, into the text make
+// writes, so the file's contents are only stored once.
+static string words_text (const wordvec& words)
+{
+   string text;
+   for (size_t ind = 2; ind < words.size(); ++ind)
+   {
+      if (ind > 2) text += ' ';
+      text += words[ind];
+   }
+   return text;
+}
 
 void fn_make (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
@@ -248,12 +706,7 @@ void fn_make (inode_state& state, const wordvec& words){
       if (existing->get_type() == DIR_INODE)
          throw yshell_exn ("make: " + words[1] + 
                            ": Cannot write to directory");
-      wordvec filedata;
-      for (size_t i = 2; i < words.size(); ++i)
-      {
-         filedata.push_back (words[i]);
-      }
-      (*existing).writefile (filedata);
+      existing->writefile (words_text (words));
       return;
    }
    
@@ -276,17 +729,16 @@ void fn_make (inode_state& state, const wordvec& words){
       parent = state.inode_from_path (path_str);
    }
    
+   if (parent == nullptr)
+      throw yshell_exn ("make: " + words[1] + 
+                        ": Parent directory does not exist");
+   
+   // Check the text and the new inode together, so a file that
+   // won't fit is never made.
+   string text = words_text (words);
+   parent->check_quota (text.size(), 1);
    inode& child = (*parent).mkfile (fname);
-   if (words.size() > 2)
-   {
-      // Write the remaining words to the file
-      wordvec filedata;
-      for (size_t ind = 2; ind < words.size(); ++ind)
-      {
-         filedata.push_back (words[ind]);
-      }
-      (child).writefile (filedata);
-   }
+   child.writefile (move (text));
 }
 
 void fn_mkdir (inode_state& state, const wordvec& words){
@@ -347,13 +799,97 @@ void fn_prompt (inode_state& state, const wordvec& words){
 void fn_pwd (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   string wd = "";
-   pwd_recursive (state, state.get_cwd(), wd);
-   if (state.get_cwd() == state.get_root()) wd += "/";
-   cout << wd << endl;
+   state.output() << state.get_cwd_path() << endl;
+}
+
+// One limit for quota:  a count, or - for none.
+static uint64_t quota_limit (const string& word)
+{
+   if (word == "-") return dir_quota::unlimited;
+   size_t idx {};
+   uint64_t limit {};
+   try {limit = stoull (word, &idx);}
+   catch (exception&) {idx = 0;}
+   if (idx == 0 or idx != word.size() or word[0] == '-')
+      throw yshell_exn ("quota: " + word + ": Invalid limit");
+   return limit;
+}
+
+static string quota_usage (uint64_t used, uint64_t limit)
+{
+   return to_string (used) + " of "
+        + (limit == dir_quota::unlimited ? "unlimited"
+                                         : to_string (limit));
+}
+
+// quota path [bytes inodes | none]
+void fn_quota (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() < 2 or words.size() > 4
+       or (words.size() == 3 and words[2] != "none"))
+      throw yshell_exn ("quota: Invalid arguments");
+   inode *dir = state.inode_from_path (words[1]);
+   if (dir == nullptr or dir->get_type() != DIR_INODE)
+      throw yshell_exn ("quota: " + words[1] + ": No such directory");
+   if (words.size() == 3)
+   {
+      dir->clear_quota();
+      return;
+   }
+   if (words.size() == 4)
+   {
+      dir->set_quota ({quota_limit (words[2]), quota_limit (words[3])});
+      return;
+   }
+   const dir_quota* limits = dir->get_quota();
+   uint64_t unlimited = dir_quota::unlimited;
+   outbuf out (state.output());
+   out << words[1] + ": bytes "
+        + quota_usage (dir->total_bytes(),
+                       limits ? limits->bytes : unlimited)
+        + ", inodes "
+        + quota_usage (dir->total_inodes(),
+                       limits ? limits->inodes : unlimited)
+        + "\n";
+}
+
+//
+// move_in_history -
+//    Runs an undo, redo or rollback.  That may take away cwd, in
+//    which case cwd goes to wherever its path now leads, or to
+//    the root.  So the path is worked out first.
+//
+template <typename move_t>
+static void move_in_history (inode_state& state, const string& cmd,
+                             move_t move)
+{
+   state.get_cwd_path();
+   try {
+      move (state.history());
+   }catch (yshell_exn& exn) {
+      throw yshell_exn (cmd + ": " + exn.what());
+   }
+   if (not state.check_cwd())
+      state.output() << cmd << ": working directory is gone;  now at /"
+                     << endl;
+}
+
+void fn_redo (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 1)
+      throw yshell_exn ("redo: Invalid arguments");
+   move_in_history (state, "redo", [] (tree_history& history) {
+      history.redo();
+   });
 }
 
-void fn_rm (inode_state& state, const wordvec& words){
+void fn_rm (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    
@@ -365,7 +901,7 @@ void fn_rm (inode_state& state, const wordvec& words){
    if (existing == nullptr)
       throw yshell_exn ("rm: " + words[1] + 
                         ": No such file or directory");
-   if (existing->get_type() == DIR_INODE && existing->size() > 2)
+   if (existing->get_type() == DIR_INODE && not existing->empty())
       throw yshell_exn ("rm: " + words[1] + 
                         ": Can't remove non-empty directory");
    // Last entry in path will be file to remove
@@ -393,7 +929,8 @@ void fn_rm (inode_state& state, const wordvec& words){
    parent->remove (fname);
 }
 
-void fn_rmr (inode_state& state, const wordvec& words){
+void fn_rmr (inode_state& state, const wordvec& args){
+   wordvec words = expand_globs (state, args);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    
@@ -430,6 +967,92 @@ void fn_rmr (inode_state& state, const wordvec& words){
    parent->remove (fname);
 }
 
+void fn_rollback (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 2)
+      throw yshell_exn ("rollback: Invalid arguments");
+   const string& name = words[1];
+   move_in_history (state, "rollback", [&] (tree_history& history) {
+      history.rollback (name);
+   });
+}
+
+void fn_save (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 2)
+      throw yshell_exn ("save: Invalid arguments");
+   try {
+      state.save (words[1]);
+   }catch (yshell_exn& exn) {
+      throw yshell_exn (string ("save: ") + exn.what());
+   }
+}
+
+// snapshot [name | -d name]
+void fn_snapshot (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   tree_history& history = state.history();
+   if (words.size() == 1)
+   {
+      outbuf out (state.output());
+      for (const auto& snap: history.list_snapshots())
+      {
+         long count = snap.second;
+         out << snap.first + ": "
+              + to_string (count < 0 ? -count : count)
+              + (count < 0 ? " commands undone\n" : " commands ago\n");
+      }
+   }
+   else if (words.size() == 2 and words[1].front() != '-')
+   {
+      history.snapshot (words[1]);
+   }
+   else if (words.size() == 3 and words[1] == "-d")
+   {
+      try {
+         history.drop_snapshot (words[2]);
+      }catch (yshell_exn& exn) {
+         throw yshell_exn (string ("snapshot: ") + exn.what());
+      }
+   }
+   else throw yshell_exn ("snapshot: Invalid arguments");
+}
+
+void fn_stats (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() > 2)
+      throw yshell_exn ("stats: Invalid arguments");
+   if (words.size() == 1)
+   {
+      if (not command_stats::is_enabled())
+         throw yshell_exn ("stats: Not enabled;  use stats on");
+      command_stats::report (state.output());
+   }
+   else if (words[1] == "on") command_stats::enable (true);
+   else if (words[1] == "off") command_stats::enable (false);
+   else if (words[1] == "clear") command_stats::clear();
+   else throw yshell_exn ("stats: " + words[1] + ": Invalid argument");
+}
+
+void fn_undo (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   
+   if (words.size() != 1)
+      throw yshell_exn ("undo: Invalid arguments");
+   move_in_history (state, "undo", [] (tree_history& history) {
+      history.undo();
+   });
+}
+
 int exit_status_message() {
    int exit_status = exit_status::get();
    cout << execname() << ": exit(" << exit_status << ")" << endl;
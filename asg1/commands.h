@@ -5,6 +5,7 @@
 #define __COMMANDS_H__
 
 #include <map>
+#include <set>
 
 using namespace std;
 
@@ -24,9 +25,15 @@ typedef map<string, function> commandmap;
 //    Each command "foo" is interpreted by a function fn_foo.
 // ctor -
 //    The default ctor initializes the map.
-// operator[] -
-//    Given a string, returns a function associated with it,
-//    or 0 if not found.
+// at -
+//    Given a string, returns the function associated with it,
+//    or throws yshell_exn if there is none.
+// find -
+//    Like at, but returns nullptr if there is none.
+// reads_only -
+//    True for a command that never changes the tree, so that in
+//    server mode it can run alongside other readers.  save is not
+//    one:  two saves to the same file must not overlap.
 //
 
 class commands {
@@ -40,6 +47,8 @@ class commands {
    public:
       commands();
       function at (const string& cmd);
+      function find (const string& cmd) const;
+      bool reads_only (const string& cmd) const;
 };
 
 
@@ -50,24 +59,50 @@ class commands {
 
 void fn_cat    (inode_state& state, const wordvec& words);
 void fn_cd     (inode_state& state, const wordvec& words);
+void fn_cp     (inode_state& state, const wordvec& words);
+void fn_du     (inode_state& state, const wordvec& words);
 void fn_echo   (inode_state& state, const wordvec& words);
 void fn_exit   (inode_state& state, const wordvec& words);
+void fn_export (inode_state& state, const wordvec& words);
+void fn_find   (inode_state& state, const wordvec& words);
+void fn_import (inode_state& state, const wordvec& words);
 void fn_ls     (inode_state& state, const wordvec& words);
+void fn_ln     (inode_state& state, const wordvec& words);
+void fn_load   (inode_state& state, const wordvec& words);
 void fn_lsr    (inode_state& state, const wordvec& words);
 void fn_make   (inode_state& state, const wordvec& words);
 void fn_mkdir  (inode_state& state, const wordvec& words);
 void fn_prompt (inode_state& state, const wordvec& words);
 void fn_pwd    (inode_state& state, const wordvec& words);
+void fn_quota  (inode_state& state, const wordvec& words);
+void fn_redo   (inode_state& state, const wordvec& words);
 void fn_rm     (inode_state& state, const wordvec& words);
 void fn_rmr    (inode_state& state, const wordvec& words);
+void fn_rollback (inode_state& state, const wordvec& words);
+void fn_save   (inode_state& state, const wordvec& words);
+void fn_snapshot (inode_state& state, const wordvec& words);
+void fn_stats  (inode_state& state, const wordvec& words);
+void fn_undo   (inode_state& state, const wordvec& words);
+
+//
+// run_command -
+//    Runs one command line, words[0] naming the command, the same
+//    way for every front end:  a command that may change the tree
+//    starts a new step of the undo history, every command is timed
+//    for stats, and once it has run it is logged in the journal.
+//    fn, if given, is cmdmap.at (words[0]), already looked up.
+//    Throws whatever the command throws, after taking back any
+//    change it made, so a command that fails is never journaled
+//    and leaves nothing behind for a replay to miss.
+//
+
+void run_command (inode_state& state, commands& cmdmap,
+                  const wordvec& words, function fn = nullptr);
 
 // Helper Functions
 
-// Stores a string representing the full path of the given inode
-// Does not work on '/' or FILE_INODES
-void pwd_recursive (inode_state& state, inode *cwd, string &result);
-// Used by fn_lsr
-void ls_recursive (inode_state& state, inode *cd);
+// Used by fn_lsr.  Lists cd and every directory under it.
+void ls_recursive (inode *cd, outbuf& out);
 
 //
 // exit_status_message -
@@ -0,0 +1,39 @@
+// $Id: dcache.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+using namespace std;
+
+#include "dcache.h"
+#include "debug.h"
+#include "inode.h"
+
+inode* dentry_cache::lookup (inode* dir, const string& name)
+{
+   if (entries.size() >= max_entries || names.size() >= max_entries)
+   {
+      DEBUGF ('d', "clearing " << entries.size() << " entries");
+      entries.clear();
+      names.clear();
+   }
+   key_t key {dir->inode_nr, &*names.insert (name).first};
+   auto found = entries.find (key);
+   if (found != entries.end()) return found->second;
+
+   dir->load_dirents();
+   directory* dirents = dir->contents.dirents;
+   auto dirent = dirents->find (name);
+   inode* result = dirent == dirents->end() ? nullptr : dirent->second;
+   entries.insert (make_pair (key, result));
+   DEBUGF ('d', "miss: " << dir->inode_nr << " " << name << " -> "
+           << result);
+   return result;
+}
+
+void dentry_cache::invalidate (const inode* dir, const string& name)
+{
+   // A name that was never interned can't be in any key.
+   auto interned = names.find (name);
+   if (interned == names.end()) return;
+   entries.erase (key_t {dir->inode_nr, &*interned});
+}
+
@@ -0,0 +1,60 @@
+// $Id: dcache.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __DCACHE_H__
+#define __DCACHE_H__
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+class inode;
+
+//
+// dentry_cache -
+//    Remembers the result of looking up one path component in one
+//    directory, including misses.  Entries are keyed by the
+//    directory's inode number, which is never reused, and by an
+//    interned copy of the component, so a name that appears in
+//    many paths is stored once.
+//
+// lookup -
+//    Returns the inode called name in dir, or nullptr if there is
+//    none.  Reads through to the directory on a miss.
+// invalidate -
+//    Drops the entry for one name in dir.  Called by anything that
+//    adds or removes a dirent.
+//
+// Nothing is done when a directory is deleted:  its entries are
+// keyed by an inode number that is gone for good, so they can't be
+// found again, and they go when the tables get too big and are
+// simply cleared.
+//
+
+class dentry_cache {
+   private:
+      struct key_t {
+         int dir_nr;
+         const string* name;
+         bool operator== (const key_t& that) const {
+            return dir_nr == that.dir_nr && name == that.name;
+         }
+      };
+      struct key_hash {
+         size_t operator() (const key_t& key) const {
+            return hash<int>() (key.dir_nr) * 31
+                 ^ hash<const string*>() (key.name);
+         }
+      };
+      static const size_t max_entries = 1 << 20;
+      unordered_set<string> names;
+      unordered_map<key_t, inode*, key_hash> entries;
+   public:
+      inode* lookup (inode* dir, const string& name);
+      void invalidate (const inode* dir, const string& name);
+};
+
+#endif
+
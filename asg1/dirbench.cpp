@@ -0,0 +1,101 @@
+// $Id: dirbench.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+//
+// dirbench -
+//    Times the two directory containers, std::map and dirmap, at
+//    lookup, insert, erase and ordered iteration for directories of
+//    10, 1k, 100k and 1M entries.  Prints nanoseconds per entry.
+//    The first iteration after a change includes dirmap's sort;
+//    "again" is a second pass over the same directory.
+//    Not part of yshell;  built by "make dirbench".
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "dirmap.h"
+
+typedef chrono::steady_clock bench_clock;
+
+static double ns_per (bench_clock::time_point start, size_t ops)
+{
+   chrono::duration<double, nano> elapsed = bench_clock::now() - start;
+   return elapsed.count() / ops;
+}
+
+// Repeat small sizes so each measurement covers about 1M entries.
+template <typename dir_t>
+static void bench (const string& label, const vector<string>& names)
+{
+   static int dummy;
+   size_t rounds = max<size_t> (1, 1000000 / names.size());
+   size_t ops = rounds * names.size();
+   double insert_ns = 0, lookup_ns = 0, erase_ns = 0;
+   double iterate_ns[2] = {0, 0};
+   size_t found = 0;
+   for (size_t round = 0; round < rounds; ++round)
+   {
+      dir_t dir;
+      auto start = bench_clock::now();
+      for (const auto& name: names)
+      {
+         dir.insert (make_pair (name, &dummy));
+      }
+      insert_ns += ns_per (start, ops);
+
+      start = bench_clock::now();
+      for (const auto& name: names) found += dir.count (name);
+      lookup_ns += ns_per (start, ops);
+
+      for (double& pass_ns: iterate_ns)
+      {
+         start = bench_clock::now();
+         for (auto itor = dir.begin(); itor != dir.end(); ++itor)
+         {
+            found += itor->first.size();
+         }
+         pass_ns += ns_per (start, ops);
+      }
+
+      start = bench_clock::now();
+      for (const auto& name: names) dir.erase (name);
+      erase_ns += ns_per (start, ops);
+   }
+   cout << setw (8) << label << setw (9) << names.size()
+        << fixed << setprecision (1)
+        << setw (10) << insert_ns << setw (10) << lookup_ns
+        << setw (10) << iterate_ns[0] << setw (10) << iterate_ns[1]
+        << setw (10) << erase_ns
+        << "   (" << found << ")" << endl;
+}
+
+int main() {
+   cout << "     dir  entries    insert    lookup   iterate     again"
+        << "     erase" << endl;
+   mt19937 random (109);
+   for (size_t size: {10, 1000, 100000, 1000000})
+   {
+      vector<string> names;
+      for (size_t nr = 0; nr < size; ++nr)
+      {
+         char name[32];
+         snprintf (name, sizeof name, "file%07zu.txt", nr);
+         names.push_back (name);
+      }
+      shuffle (names.begin(), names.end(), random);
+      bench<map<string, int*>> ("map", names);
+      bench<dirmap<int*>> ("dirmap", names);
+   }
+   return 0;
+}
+
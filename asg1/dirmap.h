@@ -0,0 +1,109 @@
+// $Id: dirmap.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __DIRMAP_H__
+#define __DIRMAP_H__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//
+// dirmap -
+//    A map from filenames to Value for use as a directory.  The
+//    entries live in one open-addressing hash table (linear
+//    probing, backward-shift deletion) instead of a tree node per
+//    entry, so a lookup in a wide directory touches a few adjacent
+//    slots.  Ordered iteration, which only ls needs, goes through a
+//    sorted array of pointers that is built on the first begin()
+//    after a change.
+//
+//    It has the part of the std::map interface that yshell uses, so
+//    either can be chosen as the directory type (see inode.h).
+//
+// find -
+//    Returns an iterator that can be dereferenced and compared
+//    with end(), but not incremented.
+// insert -
+//    Does nothing if the name is already there, like map.
+// begin/end -
+//    Iterate in name order.  Any insert or erase invalidates all
+//    iterators.  Several threads may call begin at once, as long
+//    as none is changing the map, even though it may sort.
+// lower_bound -
+//    Like begin, but starts at the first name not less than name.
+// for_each -
+//    Calls function on every entry in slot order, which is no
+//    order at all, without building the sorted view.  function
+//    must not insert or erase.
+//
+
+template <typename Value>
+class dirmap {
+   public:
+      typedef string key_type;
+      typedef Value mapped_type;
+      typedef pair<string, Value> value_type;
+      class iterator;
+      typedef iterator const_iterator;
+      dirmap();
+      dirmap (const dirmap&);
+      dirmap& operator= (const dirmap&);
+      size_t size() const { return count_; }
+      bool empty() const { return count_ == 0; }
+      size_t count (const string& name) const;
+      Value& at (const string& name);
+      iterator find (const string& name) const;
+      bool insert (const value_type& entry);
+      size_t erase (const string& name);
+      iterator begin() const;
+      iterator end() const;
+      iterator lower_bound (const string& name) const;
+      iterator cbegin() const { return begin(); }
+      iterator cend() const { return end(); }
+      template <typename Function>
+      void for_each (Function function) const;
+   private:
+      struct slot_t {
+         size_t hash; // 0 means empty
+         value_type entry;
+      };
+      vector<slot_t> slots;
+      size_t count_;
+      // Sorted pointers to every entry, followed by a nullptr.
+      mutable vector<value_type*> sorted;
+      mutable atomic<bool> sorted_valid;
+      static size_t hash_of (const string& name);
+      static mutex& sort_lock (const dirmap* map);
+      size_t slot_of (const string& name, size_t hash) const;
+      void grow();
+};
+
+template <typename Value>
+class dirmap<Value>::iterator {
+      friend class dirmap<Value>;
+   private:
+      value_type* const* pos;
+      value_type* entry;
+      iterator (value_type* const* pos, value_type* entry):
+                pos (pos), entry (entry) {}
+   public:
+      iterator(): pos (nullptr), entry (nullptr) {}
+      value_type& operator*() const { return *entry; }
+      value_type* operator->() const { return entry; }
+      iterator& operator++();
+      bool operator== (const iterator& that) const {
+         return entry == that.entry;
+      }
+      bool operator!= (const iterator& that) const {
+         return entry != that.entry;
+      }
+};
+
+#include "dirmap.tcc"
+#endif
+
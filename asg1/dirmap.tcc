@@ -0,0 +1,222 @@
+// $Id: dirmap.tcc,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+
+template <typename Value>
+dirmap<Value>::dirmap(): slots(), count_ (0), sorted(),
+                         sorted_valid (false)
+{
+}
+
+// The sorted view points into the other map's slots, so it is
+// not copied.
+template <typename Value>
+dirmap<Value>::dirmap (const dirmap& that): slots (that.slots),
+            count_ (that.count_), sorted(), sorted_valid (false)
+{
+}
+
+template <typename Value>
+dirmap<Value>& dirmap<Value>::operator= (const dirmap& that)
+{
+   if (this != &that)
+   {
+      slots = that.slots;
+      count_ = that.count_;
+      sorted.clear();
+      sorted_valid.store (false, memory_order_relaxed);
+   }
+   return *this;
+}
+
+template <typename Value>
+size_t dirmap<Value>::hash_of (const string& name)
+{
+   size_t hash = std::hash<string>() (name);
+   return hash == 0 ? 1 : hash;
+}
+
+// Returns the slot holding name, or the empty slot where it
+// would go.  The table is never full, so this terminates.
+template <typename Value>
+size_t dirmap<Value>::slot_of (const string& name, size_t hash) const
+{
+   size_t mask = slots.size() - 1;
+   size_t index = hash & mask;
+   while (slots[index].hash != 0)
+   {
+      if (slots[index].hash == hash && slots[index].entry.first == name)
+         break;
+      index = (index + 1) & mask;
+   }
+   return index;
+}
+
+template <typename Value>
+void dirmap<Value>::grow()
+{
+   vector<slot_t> old;
+   old.swap (slots);
+   slots.resize (old.empty() ? 8 : old.size() * 2);
+   for (auto& slot: old)
+   {
+      if (slot.hash == 0) continue;
+      size_t index = slot_of (slot.entry.first, slot.hash);
+      slots[index].hash = slot.hash;
+      slots[index].entry.first.swap (slot.entry.first);
+      slots[index].entry.second = slot.entry.second;
+   }
+}
+
+template <typename Value>
+size_t dirmap<Value>::count (const string& name) const
+{
+   if (count_ == 0) return 0;
+   return slots[slot_of (name, hash_of (name))].hash != 0;
+}
+
+template <typename Value>
+Value& dirmap<Value>::at (const string& name)
+{
+   if (count_ > 0)
+   {
+      slot_t& slot = slots[slot_of (name, hash_of (name))];
+      if (slot.hash != 0) return slot.entry.second;
+   }
+   throw out_of_range ("dirmap::at: " + name);
+}
+
+template <typename Value>
+typename dirmap<Value>::iterator
+dirmap<Value>::find (const string& name) const
+{
+   if (count_ == 0) return end();
+   const slot_t& slot = slots[slot_of (name, hash_of (name))];
+   if (slot.hash == 0) return end();
+   return iterator (nullptr, const_cast<value_type*> (&slot.entry));
+}
+
+// Grows at 3/4 full.
+template <typename Value>
+bool dirmap<Value>::insert (const value_type& entry)
+{
+   if ((count_ + 1) * 4 > slots.size() * 3) grow();
+   size_t hash = hash_of (entry.first);
+   slot_t& slot = slots[slot_of (entry.first, hash)];
+   if (slot.hash != 0) return false;
+   slot.hash = hash;
+   slot.entry = entry;
+   ++count_;
+   sorted_valid.store (false, memory_order_relaxed);
+   return true;
+}
+
+//
+// erase -
+//    Backward-shift deletion:  after emptying a slot, move later
+//    entries of the same probe run back into the hole, so lookups
+//    never need tombstones.
+//
+template <typename Value>
+size_t dirmap<Value>::erase (const string& name)
+{
+   if (count_ == 0) return 0;
+   size_t mask = slots.size() - 1;
+   size_t hole = slot_of (name, hash_of (name));
+   if (slots[hole].hash == 0) return 0;
+   for (size_t next = (hole + 1) & mask; slots[next].hash != 0;
+        next = (next + 1) & mask)
+   {
+      size_t home = slots[next].hash & mask;
+      // Leave it if its home lies cyclically in (hole, next].
+      bool stays = hole <= next ? (hole < home && home <= next)
+                                : (hole < home || home <= next);
+      if (stays) continue;
+      slots[hole].hash = slots[next].hash;
+      slots[hole].entry.first.swap (slots[next].entry.first);
+      slots[hole].entry.second = slots[next].entry.second;
+      hole = next;
+   }
+   slots[hole].hash = 0;
+   slots[hole].entry = value_type();
+   --count_;
+   sorted_valid.store (false, memory_order_relaxed);
+   return 1;
+}
+
+// Maps share a small set of locks, which are only taken to sort.
+template <typename Value>
+mutex& dirmap<Value>::sort_lock (const dirmap* map)
+{
+   static mutex locks[64];
+   return locks[reinterpret_cast<uintptr_t> (map) / 64 % 64];
+}
+
+template <typename Value>
+typename dirmap<Value>::iterator dirmap<Value>::begin() const
+{
+   if (sorted_valid.load (memory_order_acquire))
+      return iterator (sorted.data(), sorted.front());
+   lock_guard<mutex> guard (sort_lock (this));
+   if (not sorted_valid.load (memory_order_relaxed))
+   {
+      sorted.clear();
+      sorted.reserve (count_ + 1);
+      for (auto& slot: slots)
+      {
+         if (slot.hash != 0)
+            sorted.push_back (const_cast<value_type*> (&slot.entry));
+      }
+      sort (sorted.begin(), sorted.end(),
+            [] (const value_type* left, const value_type* right) {
+               return left->first < right->first;
+            });
+      sorted.push_back (nullptr);
+      sorted_valid.store (true, memory_order_release);
+   }
+   return iterator (sorted.data(), sorted.front());
+}
+
+// A binary search of the sorted view;  the nullptr at its end
+// stays out of the search.
+template <typename Value>
+typename dirmap<Value>::iterator
+dirmap<Value>::lower_bound (const string& name) const
+{
+   begin();
+   auto found = std::lower_bound (sorted.begin(), sorted.end() - 1,
+                  name, [] (const value_type* entry, const string& key) {
+                     return entry->first < key;
+                  });
+   return iterator (&*found, *found);
+}
+
+template <typename Value>
+typename dirmap<Value>::iterator dirmap<Value>::end() const
+{
+   return iterator();
+}
+
+template <typename Value>
+template <typename Function>
+void dirmap<Value>::for_each (Function function) const
+{
+   for (const auto& slot: slots)
+   {
+      if (slot.hash != 0) function (slot.entry);
+   }
+}
+
+template <typename Value>
+typename dirmap<Value>::iterator&
+dirmap<Value>::iterator::operator++()
+{
+   assert (pos != nullptr);
+   entry = *++pos;
+   return *this;
+}
+
@@ -0,0 +1,208 @@
+// $Id: glob.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <iostream>
+
+using namespace std;
+
+#include "debug.h"
+#include "glob.h"
+
+glob::glob (const string& pattern)
+{
+   bool literal = true;
+   for (size_t pos = 0; pos < pattern.size(); ++pos)
+   {
+      position next {false, charset()};
+      unsigned char c = pattern[pos];
+      size_t close = string::npos;
+      if (c == '[')
+      {
+         // A ] right after [ or [! is part of the set.
+         size_t first = pos + 1;
+         if (first < pattern.size()
+             and (pattern[first] == '!' or pattern[first] == '^'))
+            ++first;
+         close = pattern.find (']', first + 1);
+      }
+      // The prefix ends at the first position that is not a plain
+      // character, even a set of one:  what follows a wildcard
+      // need not come first in the name.
+      if (c == '*')
+      {
+         next.star = true;
+         literal = false;
+      }
+      else if (c == '?')
+      {
+         next.chars.set();
+         literal = false;
+      }
+      else if (close != string::npos)
+      {
+         size_t item = pos + 1;
+         bool negate = pattern[item] == '!' or pattern[item] == '^';
+         if (negate) ++item;
+         for (; item < close; ++item)
+         {
+            unsigned char low = pattern[item];
+            unsigned char high = low;
+            if (item + 2 < close and pattern[item + 1] == '-')
+            {
+               high = pattern[item + 2];
+               item += 2;
+            }
+            for (unsigned ch = low; ch <= high; ++ch)
+               next.chars.set (ch);
+         }
+         if (negate) next.chars.flip();
+         pos = close;
+         literal = false;
+      }
+      else
+      {
+         if (c == '\\' and pos + 1 < pattern.size()) c = pattern[++pos];
+         next.chars.set (c);
+         if (literal) prefix_ += c;
+      }
+      positions.push_back (next);
+   }
+   if (positions.size() > 63)
+      throw yshell_exn (pattern + ": pattern too long");
+   accept_bit = uint64_t (1) << positions.size();
+   state_for (0);
+   state_for (closure (1));
+   DEBUGF ('g', pattern << ": " << positions.size()
+           << " positions, prefix \"" << prefix_ << "\"");
+}
+
+// Adds the positions reachable by letting stars match nothing.
+uint64_t glob::closure (uint64_t set) const
+{
+   for (size_t pos = 0; pos < positions.size(); ++pos)
+   {
+      if ((set >> pos & 1) and positions[pos].star)
+         set |= uint64_t (2) << pos;
+   }
+   return set;
+}
+
+int32_t glob::state_for (uint64_t set)
+{
+   auto found = state_of.find (set);
+   if (found != state_of.end()) return found->second;
+   int32_t state = state_sets.size();
+   state_sets.push_back (set);
+   moves.emplace_back();
+   moves.back().fill (-1);
+   state_of.insert (make_pair (set, state));
+   return state;
+}
+
+int32_t glob::move (int32_t state, unsigned char byte)
+{
+   int32_t next = moves[state][byte];
+   if (next >= 0) return next;
+   uint64_t from = state_sets[state];
+   uint64_t to = 0;
+   for (size_t pos = 0; pos < positions.size(); ++pos)
+   {
+      if (not (from >> pos & 1)) continue;
+      if (positions[pos].star) to |= uint64_t (1) << pos;
+      else if (positions[pos].chars.test (byte))
+         to |= uint64_t (2) << pos;
+   }
+   next = state_for (closure (to));
+   moves[state][byte] = next;
+   return next;
+}
+
+bool glob::matches (const string& name)
+{
+   int32_t state = 1;
+   for (unsigned char byte: name)
+   {
+      state = move (state, byte);
+      if (state == 0) return false;
+   }
+   return state_sets[state] & accept_bit;
+}
+
+bool glob::is_pattern (const string& word)
+{
+   for (size_t pos = 0; pos < word.size(); ++pos)
+   {
+      switch (word[pos]) {
+         case '\\': case '*': case '?': return true;
+         case '[':
+            if (word.find (']', pos + 2) != string::npos) return true;
+            break;
+      }
+   }
+   return false;
+}
+
+// Adds to found the paths matching components[index..] under dir,
+// which is spelled path.
+static void expand (inode* dir, const string& path,
+                    const wordvec& components, size_t index,
+                    wordvec& found)
+{
+   if (index == components.size())
+   {
+      found.push_back (path);
+      return;
+   }
+   const string& component = components[index];
+   bool last = index + 1 == components.size();
+   string sep = path.empty() or path.back() == '/' ? "" : "/";
+   const directory& dirents = dir->get_dirents();
+   if (not glob::is_pattern (component))
+   {
+      auto entry = dirents.find (component);
+      if (entry == dirents.end()) return;
+      if (not last and entry->second->get_type() != DIR_INODE) return;
+      expand (entry->second, path + sep + component, components,
+              index + 1, found);
+      return;
+   }
+   glob pattern (component);
+   const string& prefix = pattern.prefix();
+   bool dots = component[0] == '.';
+   for (auto entry = dirents.lower_bound (prefix);
+        entry != dirents.end()
+        and entry->first.compare (0, prefix.size(), prefix) == 0;
+        ++entry)
+   {
+      const string& name = entry->first;
+      if (name[0] == '.' and not dots) continue;
+      if (name == "." or name == "..") continue;
+      if (not last and entry->second->get_type() != DIR_INODE) continue;
+      if (not pattern.matches (name)) continue;
+      expand (entry->second, path + sep + name, components,
+              index + 1, found);
+   }
+}
+
+wordvec expand_globs (inode_state& state, const wordvec& words)
+{
+   wordvec result;
+   for (size_t index = 0; index < words.size(); ++index)
+   {
+      const string& word = words[index];
+      if (index == 0 or not glob::is_pattern (word))
+      {
+         result.push_back (word);
+         continue;
+      }
+      bool absolute = word[0] == '/';
+      wordvec found;
+      expand (absolute ? state.get_root() : state.get_cwd(),
+              absolute ? "/" : "", split (word, "/"), 0, found);
+      if (found.empty()) result.push_back (word);
+      else result.insert (result.end(), found.begin(), found.end());
+      DEBUGF ('g', word << " -> " << found);
+   }
+   return result;
+}
+
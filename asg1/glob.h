@@ -0,0 +1,83 @@
+// $Id: glob.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __GLOB_H__
+#define __GLOB_H__
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "inode.h"
+#include "util.h"
+
+//
+// glob -
+//    A shell wildcard pattern for one filename.  * matches any
+//    string, ? any one character, [abc] and [a-z] one character
+//    from the set and [!abc] or [^abc] one not in it, and \c the
+//    character c itself.  A [ with no closing ] is just a [.
+//
+//    The pattern is compiled once into positions, one per
+//    character or wildcard, and matched by a DFA built as it is
+//    used.  A DFA state is the set of positions the pattern could
+//    be at, kept as a bitmask;  its move on a byte is worked out
+//    the first time that byte comes up in that state, and then
+//    looked up.
+//
+// ctor -
+//    Compiles pattern.  Throws yshell_exn if it has more than 63
+//    positions.
+// matches -
+//    True if the whole of name matches.
+// prefix -
+//    The literal characters every match starts with.
+// is_pattern -
+//    True if word has a wildcard that is not escaped, or has an
+//    escape, which only matching takes out.
+//
+
+class glob {
+   private:
+      typedef bitset<256> charset;
+      struct position {
+         bool star;
+         charset chars;
+      };
+      vector<position> positions;
+      string prefix_;
+      uint64_t accept_bit;
+      // DFA states, by number;  0 is the dead state.
+      vector<uint64_t> state_sets;
+      vector<array<int32_t, 256>> moves;
+      unordered_map<uint64_t, int32_t> state_of;
+      uint64_t closure (uint64_t set) const;
+      int32_t state_for (uint64_t set);
+      int32_t move (int32_t state, unsigned char byte);
+   public:
+      explicit glob (const string& pattern);
+      bool matches (const string& name);
+      const string& prefix() const { return prefix_; }
+      static bool is_pattern (const string& word);
+};
+
+//
+// expand_globs -
+//    Returns words with each word after the first that is a path
+//    pattern replaced by the paths it matches, in name order.  A
+//    pattern is matched a component at a time:  a component with
+//    no wildcards is looked up, and only the names in a directory
+//    that start with a pattern's literal prefix are tried.  Names
+//    starting with a dot only match a pattern that does too.  A
+//    pattern that matches nothing is left as it is.
+//
+
+wordvec expand_globs (inode_state& state, const wordvec& words);
+
+#endif
+
@@ -0,0 +1,57 @@
+#!/bin/sh
+# $Id: globtest.sh,v 1.1 2014-04-09 17:04:58-07 - - $
+# Author: Coy Humphrey (cmhumphr)
+
+#
+# globtest.sh -
+#    Tests for wildcard expansion of path arguments.  Each test
+#    runs ls on a pattern in a tree where some names share the
+#    rest of the pattern but not its start, and compares the names
+#    listed with those expected.  A pattern that matches nothing
+#    lists nothing.
+#
+#    Usage:  sh globtest.sh yshell
+#    Exits 1 if any test fails.  Run by "make test".
+#
+
+yshell=${1:?usage: $0 yshell}
+failed=0
+setup="
+mkdir a
+make a/foo 1
+make a/boo 2
+make a/*oo 3
+make a/oo 4
+make a/fooz 5"
+
+# check pattern expected-names...
+check() {
+   pattern=$1
+   shift
+   expected="$*"
+   actual=`printf '%s\nls %s\n' "$setup" "$pattern" \
+           | "$yshell" 2>/dev/null \
+           | sed -n '/^% ls /,$p' \
+           | sed -n 's/^ *[0-9][0-9]*  *[0-9][0-9]*  *//p' \
+           | tr '\n' ' ' | sed 's/ $//'`
+   if [ "$expected" = "$actual" ]; then
+      echo "ls $pattern: ok"
+   else
+      echo "ls $pattern: FAILED"
+      echo "   expected \"$expected\", got \"$actual\""
+      failed=1
+   fi
+}
+
+check 'a/[f]oo'    foo
+check 'a/[b]oo'    boo
+check 'a/[fb]oo'   boo foo
+check 'a/[!f]oo'   '*oo' boo
+check 'a/\*oo'     '*oo'
+check 'a/\*zz'
+check 'a/?oo'      '*oo' boo foo
+check 'a/?o'       oo
+check 'a/f?o'      foo
+check 'a/fo[o]z'   fooz
+
+exit $failed
@@ -0,0 +1,286 @@
+// $Id: history.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <algorithm>
+
+using namespace std;
+
+#include "debug.h"
+#include "history.h"
+
+// Made after the current command began, so inside something that
+// undoing it takes away.
+bool tree_history::is_new (const inode* node) const
+{
+   return node->inode_nr >= first_new_nr;
+}
+
+void tree_history::begin_command()
+{
+   new_command = true;
+   first_new_nr = inode::next_inode_nr;
+   logged = 0;
+}
+
+void tree_history::end_command()
+{
+   if (logged == 0) return;
+   forget_undone (position() - logged);
+   trim();
+   logged = 0;
+}
+
+// Latest first, so each change is turned in the tree it was made
+// in.  Turned, an added entry is a removed one, and old contents
+// are the new ones, which dispose then frees.  The numbers of the
+// inodes it made are not handed out again:  the dentry cache keys
+// on directory numbers, and never forgets those of freed ones.
+void tree_history::abort_command()
+{
+   if (logged == 0) return;
+   DEBUGF ('r', "taking back " << logged << " changes");
+   for (; logged > 0; --logged)
+   {
+      change made (move (changes.back()));
+      changes.pop_back();
+      turn (made);
+      dispose (made);
+   }
+   --commands;
+   new_command = true;
+}
+
+void tree_history::mark_existing()
+{
+   first_new_nr = inode::next_inode_nr;
+}
+
+void tree_history::log (change&& made)
+{
+   made.starts_command = new_command or changes.empty();
+   if (made.starts_command)
+   {
+      new_command = false;
+      ++commands;
+   }
+   changes.push_back (move (made));
+   ++logged;
+}
+
+void tree_history::entry_added (inode* dir, const string& name,
+                                inode* node)
+{
+   if (is_new (dir)) return;
+   log ({ENTRY_ADDED, false, dir, node, name, nullptr, nullptr});
+}
+
+void tree_history::entry_removed (inode* dir, const string& name,
+                                  inode* node)
+{
+   if (is_new (dir))
+   {
+      inode_tree::delete_tree (node);
+      return;
+   }
+   if (node->type == DIR_INODE) ++inode_tree::generation_;
+   log ({ENTRY_REMOVED, false, dir, node, name, nullptr, nullptr});
+}
+
+void tree_history::data_replaced (inode* file, blob* old)
+{
+   if (is_new (file) or old == file->contents.data)
+   {
+      blob_store::release (old);
+      return;
+   }
+   log ({DATA, false, file, nullptr, string(), old, nullptr});
+}
+
+void tree_history::quota_replaced (inode* dir,
+                                   unique_ptr<dir_quota> old)
+{
+   if (is_new (dir)) return;
+   log ({QUOTA, false, dir, nullptr, string(), nullptr, move (old)});
+}
+
+//
+// turn -
+//    Undoes a change, and makes it the change that undoes that:
+//    an added entry is detached and becomes a removed one, and
+//    the other way round, and contents and quotas are swapped
+//    with the ones kept.  No quota is checked, since this only
+//    ever goes back to a tree there once was.
+//
+void tree_history::turn (change& made)
+{
+   switch (made.kind)
+   {
+      case ENTRY_ADDED:
+         made.where->detach (made.name, made.node);
+         if (made.node->type == DIR_INODE) ++inode_tree::generation_;
+         made.kind = ENTRY_REMOVED;
+         break;
+      case ENTRY_REMOVED:
+         made.where->attach (made.name, made.node);
+         made.kind = ENTRY_ADDED;
+         break;
+      case DATA:
+      {
+         inode* file = made.where;
+         int64_t delta = int64_t (made.data->bytes.size())
+                       - int64_t (file->contents.data->bytes.size());
+         swap (file->contents.data, made.data);
+         file->charge_links (delta);
+         break;
+      }
+      case QUOTA:
+         if (made.where->quota == nullptr) ++inode::quota_count;
+         if (made.quota == nullptr) --inode::quota_count;
+         swap (made.where->quota, made.quota);
+         break;
+   }
+}
+
+// Frees what only the change was keeping.
+void tree_history::dispose (change& made)
+{
+   switch (made.kind)
+   {
+      case ENTRY_REMOVED:
+         inode_tree::delete_tree (made.node);
+         break;
+      case DATA:
+         blob_store::release (made.data);
+         break;
+      case ENTRY_ADDED:
+      case QUOTA:
+         break;
+   }
+}
+
+// Snapshots of a point that can no longer be redone, past where
+// the command began at from, go too.
+void tree_history::forget_undone (uint64_t from)
+{
+   if (undone.empty()) return;
+   for (auto& made: undone) dispose (made);
+   undone.clear();
+   for (auto snap = snapshots.begin(); snap != snapshots.end(); )
+   {
+      if (snap->second > from) snap = snapshots.erase (snap);
+      else ++snap;
+   }
+}
+
+// Drops the oldest commands past undo_limit, unless a snapshot
+// still needs them.
+void tree_history::trim()
+{
+   uint64_t keep = position();
+   for (const auto& snap: snapshots) keep = min (keep, snap.second);
+   while (commands > undo_limit)
+   {
+      size_t end = 1;
+      while (end < changes.size() and not changes[end].starts_command)
+         ++end;
+      if (dropped + end > keep) break;
+      for (; end > 0; --end)
+      {
+         dispose (changes.front());
+         changes.pop_front();
+         ++dropped;
+      }
+      --commands;
+   }
+   DEBUGF ('r', commands << " commands, " << changes.size()
+           << " changes, " << dropped << " dropped");
+}
+
+void tree_history::undo()
+{
+   if (changes.empty()) throw yshell_exn ("Nothing to undo");
+   bool first;
+   do {
+      change made (move (changes.back()));
+      changes.pop_back();
+      turn (made);
+      first = made.starts_command;
+      undone.push_back (move (made));
+   } while (not first);
+   --commands;
+   new_command = true;
+}
+
+// A command's first change is at the back of undone, so the
+// command ends before the next change that starts one.
+void tree_history::redo()
+{
+   if (undone.empty()) throw yshell_exn ("Nothing to redo");
+   do {
+      change made (move (undone.back()));
+      undone.pop_back();
+      turn (made);
+      changes.push_back (move (made));
+   } while (not undone.empty() and not undone.back().starts_command);
+   ++commands;
+   new_command = true;
+}
+
+void tree_history::snapshot (const string& name)
+{
+   snapshots[name] = position();
+   new_command = true;
+   DEBUGF ('r', name << " at " << position());
+}
+
+void tree_history::drop_snapshot (const string& name)
+{
+   if (snapshots.erase (name) == 0)
+      throw yshell_exn (name + ": No such snapshot");
+}
+
+void tree_history::rollback (const string& name)
+{
+   auto found = snapshots.find (name);
+   if (found == snapshots.end())
+      throw yshell_exn (name + ": No such snapshot");
+   uint64_t target = found->second;
+   while (position() > target) undo();
+   while (position() < target) redo();
+}
+
+// Commands since a snapshot;  negative for one that has been
+// undone past, counting the commands redo would take to get back.
+vector<pair<string, long>> tree_history::list_snapshots() const
+{
+   vector<pair<string, long>> result;
+   for (const auto& snap: snapshots)
+   {
+      long count = 0;
+      for (uint64_t pos = snap.second; pos < position(); ++pos)
+         count += changes[pos - dropped].starts_command;
+      for (size_t index = 0; index < undone.size(); ++index)
+      {
+         uint64_t pos = position() + undone.size() - 1 - index;
+         if (pos < snap.second and undone[index].starts_command)
+            --count;
+      }
+      result.push_back (make_pair (snap.first, count));
+   }
+   return result;
+}
+
+void tree_history::clear()
+{
+   for (auto& made: changes) dispose (made);
+   for (auto& made: undone) dispose (made);
+   changes.clear();
+   undone.clear();
+   snapshots.clear();
+   dropped = 0;
+   commands = 0;
+   new_command = true;
+   logged = 0;
+   first_new_nr = inode::next_inode_nr;
+}
+
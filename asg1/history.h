@@ -0,0 +1,127 @@
+// $Id: history.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "inode.h"
+
+//
+// tree_history -
+//    What undo, redo, snapshot and rollback work from:  a log of
+//    the changes made to the tree, each of which can be turned
+//    around in place.  A removed entry is detached rather than
+//    freed, and the log holds on to it, so putting it back costs
+//    the same however big it is;  a file's old contents are kept
+//    as a reference to their blob.  The changes made by one
+//    command are undone and redone together.
+//
+//    Changes inside a directory made by the same command are not
+//    logged, since undoing that command takes the directory away
+//    whole.  So cp and import log one change each.
+//
+//    Only the last undo_limit commands are kept, plus everything
+//    after the oldest snapshot, so the memory held is in
+//    proportion to what changed since then.  Anything new throws
+//    away what could be redone.  Loading an image, and a journal
+//    checkpoint, forget everything.
+//
+//    A command that fails is taken back whole, so every command
+//    either changes the tree and the history as it meant to or
+//    changes neither.  Nothing a command logs touches what was
+//    there before it, until it ends:  what could be redone, and
+//    old commands past undo_limit, are only let go of then.
+//
+// begin_command/end_command/abort_command -
+//    Starts a command, and ends it once it has run, or turns back
+//    every change it made if it threw.  Called around each command
+//    that may change the tree, under the write lock in server
+//    mode.
+// mark_existing -
+//    Everything made so far counts as being there before the
+//    current command, and so has its changes logged.  For inodes
+//    made by loading a directory from an image.
+// entry_added/entry_removed/data_replaced/quota_replaced -
+//    Called by inode after each change.  entry_removed takes over
+//    the node, which is already detached, and data_replaced and
+//    quota_replaced the old contents or quota;  each frees it
+//    there and then if it need not be kept.
+// undo/redo -
+//    Turns around the changes of the last command, or of the last
+//    one undone.  Throws yshell_exn if there is none.
+// snapshot/drop_snapshot/rollback -
+//    Names the present point in the log, forgets the name, or
+//    undoes or redoes commands until the log is back at it.
+// list_snapshots -
+//    Each snapshot and the number of commands made since, or
+//    minus the number to redo for one that was undone past.
+// clear -
+//    Forgets everything, freeing what was only kept for it.
+//
+
+class tree_history {
+   private:
+      tree_history (const tree_history&) = delete;
+      tree_history& operator= (const tree_history&) = delete;
+      enum change_t {ENTRY_ADDED, ENTRY_REMOVED, DATA, QUOTA};
+      struct change {
+         change_t kind;
+         bool starts_command;
+         // The directory for an entry or quota, the file for data
+         inode* where;
+         inode* node;
+         string name;
+         blob* data;
+         unique_ptr<dir_quota> quota;
+      };
+      static const size_t undo_limit = 100;
+      deque<change> changes;
+      vector<change> undone;
+      // Changes dropped from the front, so that changes[index] is
+      // change number dropped + index.
+      uint64_t dropped {0};
+      size_t commands {0};
+      bool new_command {true};
+      // Changes logged since begin_command
+      size_t logged {0};
+      int first_new_nr {INT_MAX};
+      map<string, uint64_t> snapshots;
+      bool is_new (const inode* node) const;
+      void log (change&& made);
+      void forget_undone (uint64_t from);
+      void trim();
+      static void turn (change& made);
+      static void dispose (change& made);
+      uint64_t position() const { return dropped + changes.size(); }
+   public:
+      tree_history() {}
+      void begin_command();
+      void end_command();
+      void abort_command();
+      void mark_existing();
+      void entry_added (inode* dir, const string& name, inode* node);
+      void entry_removed (inode* dir, const string& name,
+                          inode* node);
+      void data_replaced (inode* file, blob* old);
+      void quota_replaced (inode* dir, unique_ptr<dir_quota> old);
+      void undo();
+      void redo();
+      void snapshot (const string& name);
+      void drop_snapshot (const string& name);
+      void rollback (const string& name);
+      vector<pair<string, long>> list_snapshots() const;
+      void clear();
+};
+
+#endif
+
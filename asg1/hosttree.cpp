@@ -0,0 +1,258 @@
+// $Id: hosttree.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "hosttree.h"
+#include "walk.h"
+
+namespace {
+
+   // Closes a file descriptor on the way out of a scope.
+   struct fd_closer {
+      int fd;
+      explicit fd_closer (int fd): fd (fd) {}
+      ~fd_closer() { if (fd >= 0) close (fd); }
+   };
+
+   // The record getdents64 fills in, one after another.
+   struct linux_dirent64 {
+      ino64_t d_ino;
+      off64_t d_off;
+      unsigned short d_reclen;
+      unsigned char d_type;
+      char d_name[];
+   };
+
+   struct host_file {
+      string name;
+      string data;
+   };
+
+   //
+   // A directory read from the host, waiting to be added.  parent
+   // is the inode it goes under, made by the level before.  The
+   // first error reading it or its files is kept for the report.
+   //
+   struct host_dir {
+      string path;
+      string name;
+      inode* parent;
+      vector<host_file> files;
+      vector<string> subdirs;
+      string error;
+      size_t errors {0};
+      void fail (const string& where, int errnum) {
+         if (errors++ == 0) error = where + ": " + strerror (errnum);
+      }
+   };
+
+   // Reads the whole of a file that is already open.
+   bool read_all (int fd, string& data)
+   {
+      struct stat info;
+      if (fstat (fd, &info) < 0) return false;
+      data.resize (info.st_size);
+      size_t done = 0;
+      for (;;)
+      {
+         if (done == data.size()) data.resize (done + 4096);
+         ssize_t bytes = read (fd, &data[done], data.size() - done);
+         if (bytes < 0 and errno == EINTR) continue;
+         if (bytes < 0) return false;
+         if (bytes == 0) break;
+         done += bytes;
+      }
+      data.resize (done);
+      return true;
+   }
+
+   // The kind of an entry, from getdents64 if the filesystem gives
+   // it, or else from fstatat.
+   unsigned char type_of (int dirfd, const linux_dirent64& entry)
+   {
+      if (entry.d_type != DT_UNKNOWN) return entry.d_type;
+      struct stat info;
+      if (fstatat (dirfd, entry.d_name, &info, AT_SYMLINK_NOFOLLOW) < 0)
+         return DT_UNKNOWN;
+      if (S_ISDIR (info.st_mode)) return DT_DIR;
+      if (S_ISREG (info.st_mode)) return DT_REG;
+      return DT_UNKNOWN;
+   }
+
+   // Runs in a worker thread, so it only touches dir.
+   void scan (host_dir& dir, bool metadata_only)
+   {
+      int dirfd = open (dir.path.c_str(), O_RDONLY | O_DIRECTORY
+                                          | O_NOFOLLOW | O_CLOEXEC);
+      if (dirfd < 0)
+      {
+         dir.fail (dir.path, errno);
+         return;
+      }
+      fd_closer closer (dirfd);
+      alignas (linux_dirent64) char buffer[1 << 16];
+      for (;;)
+      {
+         long bytes = syscall (SYS_getdents64, dirfd, buffer,
+                               sizeof buffer);
+         if (bytes < 0 and errno == EINTR) continue;
+         if (bytes < 0) dir.fail (dir.path, errno);
+         if (bytes <= 0) break;
+         for (long offset = 0; offset < bytes; )
+         {
+            auto& entry = *reinterpret_cast<linux_dirent64*>
+                          (buffer + offset);
+            offset += entry.d_reclen;
+            if (strcmp (entry.d_name, ".") == 0
+                or strcmp (entry.d_name, "..") == 0) continue;
+            unsigned char type = type_of (dirfd, entry);
+            if (type == DT_DIR)
+            {
+               dir.subdirs.push_back (entry.d_name);
+            }
+            else if (type == DT_REG)
+            {
+               dir.files.push_back ({entry.d_name, ""});
+               if (metadata_only) continue;
+               int fd = openat (dirfd, entry.d_name,
+                                O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+               fd_closer file_closer (fd);
+               if (fd < 0 or not read_all (fd, dir.files.back().data))
+               {
+                  dir.fail (dir.path + "/" + entry.d_name, errno);
+                  dir.files.pop_back();
+               }
+            }
+         }
+      }
+   }
+
+}
+
+string import_tree (const string& host_path, inode& parent,
+                    const string& name, bool metadata_only)
+{
+   vector<host_dir> level (1);
+   level[0].path = host_path;
+   level[0].name = name;
+   level[0].parent = &parent;
+   vector<host_dir> next;
+   size_t dir_count = 0, file_count = 0, errors = 0;
+   string first_error;
+   while (not level.empty())
+   {
+      parallel_for (level.size(), [&] (size_t index) {
+         scan (level[index], metadata_only);
+      });
+      // A top directory that can't be read is no import at all.
+      if (dir_count == 0 and level[0].errors > 0
+          and level[0].files.empty() and level[0].subdirs.empty())
+         throw yshell_exn (level[0].error);
+      // What is made is new, so holds no quotas:  only those at
+      // parent and above count, and they see the level whole.
+      int64_t level_bytes = 0, level_inodes = level.size();
+      for (const auto& dir: level)
+      {
+         for (const auto& file: dir.files)
+            level_bytes += file.data.size();
+         level_inodes += dir.files.size();
+      }
+      try {
+         parent.check_quota (level_bytes, level_inodes);
+      }catch (yshell_exn&) {
+         // Take away the levels already made.
+         if (dir_count > 0) parent.remove (name);
+         throw;
+      }
+      next.clear();
+      for (auto& dir: level)
+      {
+         if (dir.errors > 0 and errors == 0) first_error = dir.error;
+         errors += dir.errors;
+         inode& node = dir.parent->mkdir (dir.name);
+         for (auto& file: dir.files)
+         {
+            inode& made = node.mkfile (file.name);
+            if (not file.data.empty())
+               made.writefile (move (file.data));
+         }
+         file_count += dir.files.size();
+         for (auto& subdir: dir.subdirs)
+         {
+            next.emplace_back();
+            next.back().path = dir.path + "/" + subdir;
+            next.back().name = move (subdir);
+            next.back().parent = &node;
+         }
+      }
+      dir_count += level.size();
+      level.swap (next);
+   }
+   DEBUGF ('h', host_path << ": " << dir_count << " directories, "
+           << file_count << " files, " << errors << " errors");
+   if (errors == 0) return "";
+   return first_error + " (" + to_string (errors)
+          + " entries skipped)";
+}
+
+void export_tree (inode& top, const string& host_path,
+                  bool metadata_only)
+{
+   vector<inode*> dirs = dir_preorder (&top);
+   // Paths relative to top, so a directory's host path is
+   // host_path followed by its own path past top's.
+   size_t top_length = top.get_path().size();
+   if (top_length == 1) top_length = 0;
+   vector<string> paths (dirs.size());
+   for (size_t index = 0; index < dirs.size(); ++index)
+   {
+      paths[index] = host_path
+                   + dirs[index]->get_path().substr (top_length);
+      if (mkdir (paths[index].c_str(), 0777) < 0)
+         throw yshell_exn (paths[index] + ": " + strerror (errno));
+   }
+   mutex error_lock;
+   string first_error;
+   parallel_for (dirs.size(), [&] (size_t index) {
+      for (const auto& dirent: dirs[index]->get_dirents())
+      {
+         if (dirent.second->get_type() != FILE_INODE) continue;
+         string path = paths[index] + "/" + dirent.first;
+         int fd = open (path.c_str(),
+                        O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+         fd_closer closer (fd);
+         const string& data = dirent.second->readfile();
+         size_t done = 0;
+         while (fd >= 0 and not metadata_only and done < data.size())
+         {
+            ssize_t bytes = write (fd, data.data() + done,
+                                   data.size() - done);
+            if (bytes < 0 and errno != EINTR) break;
+            if (bytes > 0) done += bytes;
+         }
+         if (fd < 0 or (not metadata_only and done < data.size()))
+         {
+            lock_guard<mutex> guard (error_lock);
+            if (first_error.empty())
+               first_error = path + ": " + strerror (errno);
+         }
+      }
+   });
+   DEBUGF ('h', host_path << ": " << dirs.size() << " directories");
+   if (not first_error.empty()) throw yshell_exn (first_error);
+}
+
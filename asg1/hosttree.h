@@ -0,0 +1,46 @@
+// $Id: hosttree.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __HOSTTREE_H__
+#define __HOSTTREE_H__
+
+#include <string>
+
+using namespace std;
+
+#include "inode.h"
+
+//
+// Copying trees between the host filesystem and yshell.  Only
+// directories and regular files are copied;  symbolic links and
+// other kinds of file are skipped, and a link to a directory is
+// never followed.  With metadata_only, files are copied by name
+// alone and come out empty.
+//
+// import_tree -
+//    Makes a directory name in parent, holding copies of everything
+//    under the host directory host_path.  The host tree is read a
+//    level at a time:  every directory in a level is read in
+//    parallel with getdents64, and its files with it, into a
+//    staging area, and then that level is added to the tree with
+//    mkdir and mkfile by this thread alone.  Entries that can't be
+//    read are skipped, and the first of them is described in the
+//    message returned;  it is empty if there were none.  Throws
+//    yshell_exn, and makes nothing, if host_path can't be read or
+//    the copy would break a quota.  Each level is checked against
+//    the quotas before any of it is made, and a level that won't
+//    fit takes away those made before it.
+// export_tree -
+//    Creates the host directory host_path, which must not exist,
+//    and copies everything under dir into it.  Directories are
+//    made in order first, and then filled with their files in
+//    parallel.  Throws yshell_exn if anything can't be written.
+//
+
+string import_tree (const string& host_path, inode& parent,
+                    const string& name, bool metadata_only);
+void export_tree (inode& dir, const string& host_path,
+                  bool metadata_only);
+
+#endif
+
@@ -0,0 +1,294 @@
+// $Id: image.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "image.h"
+#include "walk.h"
+
+static const char MAGIC[] = "YSHIMG4\n";
+static const size_t MAGIC_LEN = sizeof MAGIC - 1;
+
+inode_image::inode_image (const string& filename)
+{
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0)
+      throw yshell_exn (filename + ": " + strerror (errno));
+   struct stat info;
+   if (fstat (fd, &info) < 0)
+   {
+      close (fd);
+      throw yshell_exn (filename + ": " + strerror (errno));
+   }
+   length = info.st_size;
+   if (length < MAGIC_LEN + 2 * sizeof (uint64_t))
+   {
+      close (fd);
+      throw yshell_exn (filename + ": not a yshell image");
+   }
+   void* addr = mmap (nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+   close (fd);
+   if (addr == MAP_FAILED)
+      throw yshell_exn (filename + ": " + strerror (errno));
+   base = static_cast<const char*> (addr);
+   if (memcmp (base, MAGIC, MAGIC_LEN) != 0)
+   {
+      munmap (const_cast<char*> (base), length);
+      throw yshell_exn (filename + ": not a yshell image");
+   }
+   DEBUGF ('m', filename << ": " << length << " bytes at "
+           << (void*) base);
+}
+
+inode_image::~inode_image()
+{
+   munmap (const_cast<char*> (base), length);
+}
+
+// Returns a pointer to bytes [offset, offset+bytes) of the image,
+// or throws if that runs off the end.
+const char* inode_image::at (uint64_t offset, size_t bytes) const
+{
+   if (offset > length || bytes > length - offset)
+      throw yshell_exn ("image: corrupt record");
+   return base + offset;
+}
+
+// Records are not aligned, so integers are copied out.
+template <typename int_t>
+static int_t read_int (const char* where)
+{
+   int_t value;
+   memcpy (&value, where, sizeof value);
+   return value;
+}
+
+// The fields at the end, counting back from the last, field 0.
+uint64_t inode_image::trailer (size_t field) const
+{
+   return read_int<uint64_t> (at (length - (field + 1)
+                                          * sizeof (uint64_t),
+                                  sizeof (uint64_t)));
+}
+
+uint64_t inode_image::root() const
+{
+   return trailer (0);
+}
+
+bool inode_image::has_links() const
+{
+   return trailer (1) > 0;
+}
+
+size_t inode_image::dirent_count (uint64_t record) const
+{
+   if (*at (record, 1) != DIR_INODE)
+      throw yshell_exn ("image: not a directory record");
+   return read_int<uint32_t> (at (record + 1, sizeof (uint32_t)));
+}
+
+// The totals and quota follow the entry count.
+static const size_t DIR_HEADER_LEN = 1 + sizeof (uint32_t)
+                                   + 4 * sizeof (uint64_t);
+
+void inode_image::read_totals (inode* dir) const
+{
+   const char* header = at (dir->image_rec, DIR_HEADER_LEN);
+   if (*header != DIR_INODE)
+      throw yshell_exn ("image: not a directory record");
+   const char* totals = header + 1 + sizeof (uint32_t);
+   uint64_t fields[4];
+   for (size_t nr = 0; nr < 4; ++nr)
+      fields[nr] = read_int<uint64_t> (totals + nr * sizeof (uint64_t));
+   if (fields[1] == 0) throw yshell_exn ("image: corrupt record");
+   dir->subtree_bytes = fields[0];
+   dir->subtree_inodes = fields[1] - 1;
+   if (fields[2] != dir_quota::unlimited
+       or fields[3] != dir_quota::unlimited)
+      dir->set_quota ({fields[2], fields[3]});
+}
+
+void inode_image::load_dirents (inode* dir) const
+{
+   uint64_t pos = dir->image_rec;
+   size_t count = dirent_count (pos);
+   pos += DIR_HEADER_LEN;
+   DEBUGF ('m', "loading " << count << " dirents for inode "
+           << dir->inode_nr);
+
+   // Read every entry before creating anything, so a corrupt
+   // record leaves the directory as it was.
+   struct entry_t {
+      string name;
+      uint64_t record;
+      string data;
+   };
+   vector<entry_t> entries (count);
+   for (auto& entry: entries)
+   {
+      uint32_t namelen = read_int<uint32_t> (at (pos, sizeof namelen));
+      pos += sizeof namelen;
+      entry.name.assign (at (pos, namelen), namelen);
+      pos += namelen;
+      entry.record = read_int<uint64_t> (at (pos, sizeof (uint64_t)));
+      pos += sizeof (uint64_t);
+      if (*at (entry.record, 1) == DIR_INODE) continue;
+      if (file_inodes.count (entry.record) > 0) continue;
+      uint64_t data_pos = read_int<uint64_t> (
+                             at (entry.record + 1, sizeof (uint64_t)));
+      uint64_t len = read_int<uint64_t> (at (data_pos, sizeof len));
+      data_pos += sizeof len;
+      entry.data.assign (at (data_pos, len), len);
+   }
+
+   // The directory's totals already count all of this.
+   bool linking = has_links();
+   for (auto& entry: entries)
+   {
+      if (*at (entry.record, 1) == DIR_INODE)
+      {
+         inode& child = dir->add_entry (entry.name, DIR_INODE);
+         child.image = this;
+         child.image_rec = entry.record;
+         read_totals (&child);
+         continue;
+      }
+      auto found = file_inodes.find (entry.record);
+      if (found != file_inodes.end())
+      {
+         dir->add_link (entry.name, *found->second);
+         continue;
+      }
+      inode& file = dir->add_entry (entry.name, FILE_INODE);
+      file.replace_data (blob_store::intern (move (entry.data)));
+      if (linking) file_inodes.insert (make_pair (entry.record, &file));
+   }
+}
+
+void inode_image::load_all (inode* root) const
+{
+   dir_preorder (root);
+   // Nothing is left to load, and the inodes are the tree's now.
+   file_inodes.clear();
+}
+
+template <typename int_t>
+static void write_int (ostream& out, uint64_t& offset, int_t value)
+{
+   out.write (reinterpret_cast<const char*> (&value), sizeof value);
+   offset += sizeof value;
+}
+
+static void write_string (ostream& out, uint64_t& offset,
+                          const string& str)
+{
+   write_int<uint32_t> (out, offset, str.size());
+   out.write (str.data(), str.size());
+   offset += str.size();
+}
+
+// Writes node and everything under it, children first, and
+// returns the offset of node's own record.
+uint64_t inode_image::write_inode (ostream& out, uint64_t& offset,
+                                   records& written, inode* node)
+{
+   if (node->type == FILE_INODE)
+   {
+      auto linked = written.files.find (node);
+      if (linked != written.files.end())
+      {
+         ++written.extra_links;
+         return linked->second;
+      }
+      uint64_t contents;
+      auto found = written.contents.find (node->contents.data);
+      if (found != written.contents.end()) contents = found->second;
+      else
+      {
+         contents = offset;
+         written.contents.insert (make_pair (node->contents.data,
+                                             contents));
+         const string& data = node->readfile();
+         write_int<uint64_t> (out, offset, data.size());
+         out.write (data.data(), data.size());
+         offset += data.size();
+      }
+      uint64_t record = offset;
+      written.files.insert (make_pair (node, record));
+      write_int<uint8_t> (out, offset, FILE_INODE);
+      write_int<uint64_t> (out, offset, contents);
+      return record;
+   }
+
+   node->load_dirents();
+   vector<pair<const string*, uint64_t>> entries;
+   for (auto& entry: *node->contents.dirents)
+   {
+      if (entry.first == "." || entry.first == "..") continue;
+      entries.push_back (make_pair (&entry.first,
+                         write_inode (out, offset, written,
+                                      entry.second)));
+   }
+   const dir_quota* limits = node->get_quota();
+   uint64_t record = offset;
+   write_int<uint8_t> (out, offset, DIR_INODE);
+   write_int<uint32_t> (out, offset, entries.size());
+   write_int<uint64_t> (out, offset, node->total_bytes());
+   write_int<uint64_t> (out, offset, node->total_inodes());
+   write_int<uint64_t> (out, offset, limits ? limits->bytes
+                                            : dir_quota::unlimited);
+   write_int<uint64_t> (out, offset, limits ? limits->inodes
+                                            : dir_quota::unlimited);
+   for (const auto& entry: entries)
+   {
+      write_string (out, offset, *entry.first);
+      write_int<uint64_t> (out, offset, entry.second);
+   }
+   return record;
+}
+
+void inode_image::write (const string& filename, inode* root)
+{
+   string tmpname = filename + ".tmp";
+   ofstream out (tmpname, ios::binary | ios::trunc);
+   if (not out)
+      throw yshell_exn (tmpname + ": " + strerror (errno));
+   out.write (MAGIC, MAGIC_LEN);
+   uint64_t offset = MAGIC_LEN;
+   records written;
+   uint64_t root_rec = write_inode (out, offset, written, root);
+   write_int<uint64_t> (out, offset, written.extra_links);
+   write_int<uint64_t> (out, offset, root_rec);
+   out.close();
+   if (not out)
+   {
+      ::remove (tmpname.c_str());
+      throw yshell_exn (filename + ": write failed");
+   }
+   // The image must be on disk before its name is, or a crash
+   // could leave the name on an empty file.
+   int fd = open (tmpname.c_str(), O_RDONLY);
+   if (fd >= 0)
+   {
+      fsync (fd);
+      close (fd);
+   }
+   if (rename (tmpname.c_str(), filename.c_str()) < 0)
+      throw yshell_exn (filename + ": " + strerror (errno));
+   DEBUGF ('m', filename << ": wrote " << offset << " bytes");
+}
+
@@ -0,0 +1,104 @@
+// $Id: image.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+#include "inode.h"
+
+//
+// inode_image -
+//    A binary snapshot of an inode tree, written by save and read
+//    back by load.  The file is mapped read-only and directories
+//    are only turned into inodes the first time they are looked at,
+//    so loading costs the same no matter how big the tree is.
+//
+// Layout (host byte order, no padding):
+//    "YSHIMG4\n"                          magic, 8 bytes
+//    records...                           children before parents
+//    uint64 extra links                   see below
+//    uint64 root                          offset of root record
+//
+//    directory record:  uint8 DIR_INODE, uint32 nentries, uint64
+//       total bytes, uint64 total inodes, uint64 quota bytes,
+//       uint64 quota inodes, then nentries x (uint32 namelen,
+//       name, uint64 offset).  The totals are those of the
+//       directory's inode, so a lazy directory has them without
+//       being read;  an unlimited quota is stored as all ones.
+//       Dot and dotdot are not stored.
+//    file record:  uint8 FILE_INODE, uint64 offset of contents.
+//       There is one per inode, so every hard link to a file
+//       names the same record.  The extra links are the number of
+//       entries naming a file record that an entry before them
+//       already named.
+//    contents record:  uint64 len, then len bytes.  Files with the
+//       same contents share one.
+//
+//    The links to a file may be in any directories, so an image
+//    with extra links is read whole when it is loaded, and each
+//    file record is made into one inode however many entries name
+//    it.  One without is read a directory at a time, as it is
+//    looked at.
+//
+// ctor -
+//    Maps the file.  Throws a yshell_exn if it can't be opened or
+//    is not an image.
+// root -
+//    Returns the offset of the root directory record.
+// dirent_count -
+//    Number of entries in a directory record, without loading it.
+// read_totals -
+//    Gives a lazy directory the totals and quota from its record.
+// has_links -
+//    Whether the image has extra links, and so must be loaded
+//    with load_all.
+// load_dirents -
+//    Fills in a lazy directory inode from its record, creating
+//    its files and lazy subdirectories.
+// load_all -
+//    Loads every directory under root, the image's root directory
+//    inode, so that every link to a file finds the inode made for
+//    it.
+// write -
+//    Writes the tree under root to filename.  The image goes to a
+//    temporary file that is renamed over filename, so an image
+//    that is currently mapped stays valid.
+//
+
+class inode_image {
+   private:
+      inode_image (const inode_image&) = delete; // copy ctor
+      inode_image& operator= (const inode_image&) = delete; // op=
+      const char* base {nullptr};
+      size_t length {0};
+      // The inode made for each file record, while load_all runs
+      mutable unordered_map<uint64_t, inode*> file_inodes;
+      const char* at (uint64_t offset, size_t bytes) const;
+      uint64_t trailer (size_t field) const;
+      struct records {
+         unordered_map<const blob*, uint64_t> contents;
+         unordered_map<const inode*, uint64_t> files;
+         uint64_t extra_links {0};
+      };
+      static uint64_t write_inode (ostream& out, uint64_t& offset,
+                                   records& written, inode* node);
+   public:
+      explicit inode_image (const string& filename);
+      ~inode_image();
+      uint64_t root() const;
+      size_t dirent_count (uint64_t record) const;
+      void read_totals (inode* dir) const;
+      bool has_links() const;
+      void load_dirents (inode* dir) const;
+      void load_all (inode* root) const;
+      static void write (const string& filename, inode* root);
+};
+
+#endif
+
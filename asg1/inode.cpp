@@ -1,71 +1,93 @@
 // $Id: inode.cpp,v 1.4 2014-04-09 17:04:58-07 - - $
 // Author: Coy Humphrey (cmhumphr)
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
 using namespace std;
 
 #include "debug.h"
+#include "history.h"
+#include "image.h"
 #include "inode.h"
+#include "pool.h"
+#include "walk.h"
 
 int inode::next_inode_nr {1};
+dentry_cache inode::dcache;
+tree_history inode::history;
+
+// Whether an insert made a new entry:  a dirmap says so with a bool,
+// a std::map (-DMAP_DIRECTORY) with the second of a pair.
+static bool inserted (bool result)
+{
+   return result;
+}
+
+template <typename iterator>
+static bool inserted (const pair<iterator, bool>& result)
+{
+   return result.second;
+}
+
+// Calls function on every entry of a directory, in whatever order
+// comes cheapest:  a dirmap's slot order, without sorting, or a
+// std::map's own.
+template <typename Function>
+static void for_each_entry (const dirmap<inode*>& dir,
+                            Function function)
+{
+   dir.for_each (function);
+}
+
+template <typename Function>
+static void for_each_entry (const map<string, inode*>& dir,
+                            Function function)
+{
+   for (const auto& entry: dir) function (entry);
+}
 
 inode::inode(inode_t init_type):
    inode_nr (next_inode_nr++), type (init_type)
 {
    switch (type) {
       case DIR_INODE:
-           contents.dirents = new directory();
+           contents.dirents = pool_new<directory>();
            break;
       case FILE_INODE:
-           contents.data = new wordvec();
+           contents.data = blob_store::intern (string());
            break;
    }
    DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
 }
 
-//
-// copy ctor -
-//    Make a copy of a given inode.  This should not be used in
-//    your program if you can avoid it, since it is expensive.
-//    Here, we can leverage operator=.
-//
-inode::inode (const inode& that) 
-{
-   *this = that;
-}
-
 // destructor
-//    Free up the memory allocated with new
+//    Free up the directory, or this file's share of its blob
 inode::~inode ()
 {
    switch (type)
    {
       case DIR_INODE:
-         delete contents.dirents;
+         pool_delete (contents.dirents);
+         if (quota != nullptr) --quota_count;
          break;
       case FILE_INODE:
-         delete contents.data;
+         blob_store::release (contents.data);
          break;
    }
 }
 
-//
-// operator= -
-//    Assignment operator.  Copy an inode.  Make a copy of a
-//    given inode.  This should not be used in your program if
-//    you can avoid it, since it is expensive.
-//
-inode& inode::operator= (const inode& that) 
+void* inode::operator new (size_t size)
 {
-   if (this != &that) {
-      inode_nr = that.inode_nr;
-      type = that.type;
-      contents = that.contents;
-   }
-   DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
-   return *this;
+   assert (size == sizeof (inode));
+   return size_class<sizeof (inode)>().allocate();
+}
+
+void inode::operator delete (void* where)
+{
+   if (where == nullptr) return;
+   size_class<sizeof (inode)>().release (where);
 }
 
 
@@ -80,14 +102,11 @@ int inode::size() const
    int size {0};
    if (type == FILE_INODE)
    {
-      for (auto i : *(contents.data))
-      {
-         // Add 1 for each word
-         size++;
-         // Add the length of each string
-         size += i.length();
-      }
-      size--; // # of words - 1 is number of spaces to be printed
+      size += contents.data->bytes.size();
+   }
+   else if (image != nullptr)
+   {
+      size += image->dirent_count (image_rec) + 2;
    }
    else
    {
@@ -97,32 +116,75 @@ int inode::size() const
    return size;
 }
 
+bool inode::empty() const
+{
+   if (type != DIR_INODE) return false;
+   if (image != nullptr) return image->dirent_count (image_rec) == 0;
+   return contents.dirents->size() <= 2;
+}
+
 inode_t inode::get_type() const
 {
    return type;
 }
 
-const wordvec& inode::readfile() const 
+const string& inode::readfile() const 
 {
-   DEBUGF ('i', *contents.data);
    if (type != FILE_INODE) 
       throw yshell_exn ("readfile called on DIR_INODE");
-   return *(contents.data);
+   DEBUGF ('i', contents.data->bytes);
+   return contents.data->bytes;
+}
+
+void inode::writefile (const string& newdata) 
+{
+   writefile (string (newdata));
 }
 
-void inode::writefile (const wordvec& words) 
+void inode::writefile (string&& newdata) 
 {
-   DEBUGF ('i', words);
+   DEBUGF ('i', newdata);
    if (type != FILE_INODE) 
       throw yshell_exn ("writefile called on DIR_INODE");
    
-   contents.data->assign (words.cbegin(), words.cend());
+   int64_t delta = int64_t (newdata.size()) - size();
+   check_links (delta);
+   change_data (blob_store::intern (move (newdata)));
+   charge_links (delta);
+}
+
+void inode::share_contents (const inode& from)
+{
+   if (type != FILE_INODE or from.type != FILE_INODE)
+      throw yshell_exn ("share_contents called on DIR_INODE");
+   int64_t delta = int64_t (from.size()) - size();
+   check_links (delta);
+   change_data (blob_store::share (from.contents.data));
+   charge_links (delta);
+}
+
+// Swaps in new contents, with no accounting.
+void inode::replace_data (blob* newdata)
+{
+   blob* old = contents.data;
+   contents.data = newdata;
+   blob_store::release (old);
+}
+
+// Swaps in new contents, with no accounting, and hands the old
+// ones to the history.
+void inode::change_data (blob* newdata)
+{
+   blob* old = contents.data;
+   contents.data = newdata;
+   history.data_replaced (this, old);
 }
 
 void inode::remove (const string& filename) 
 {
    DEBUGF ('i', filename);
    assert (type == DIR_INODE);
+   load_dirents();
    // Check to see if file exists
    if (contents.dirents->count (filename) == 0)
       throw yshell_exn ("remove: no such inode");
@@ -131,26 +193,208 @@ void inode::remove (const string& filename)
       throw yshell_exn ("remove: can't remove . or .. or /");
       
    inode *curr = contents.dirents->at (filename);
-   contents.dirents->erase (filename);
-   inode_state::recursive_delete (curr);
+   detach (filename, curr);
+   history.entry_removed (this, filename, curr);
+}
+
+// Takes node out of this directory, and its totals out of those
+// above, leaving it whole.  A directory becomes the root of its
+// own tree, so changes to files it shares with the rest of the
+// tree stop at it.
+void inode::detach (const string& entry_name, inode* node)
+{
+   charge (-int64_t (node->total_bytes()),
+           -int64_t (node->total_inodes()));
+   if (node->type == FILE_INODE) node->drop_parent (this);
+   else node->parent = node;
+   contents.dirents->erase (entry_name);
+   dcache.invalidate (this, entry_name);
+}
+
+// Puts back what detach took out.
+void inode::attach (const string& entry_name, inode* node)
+{
+   bool added = inserted (contents.dirents->insert (
+                             make_pair (entry_name, node)));
+   assert (added);
+   (void) added;
+   dcache.invalidate (this, entry_name);
+   if (node->type == FILE_INODE) node->add_parent (this);
+   else node->parent = this;
+   charge (node->total_bytes(), node->total_inodes());
+}
+
+// Makes a new entry, with no accounting;  the image uses this to
+// fill in a directory whose totals are already known.
+inode& inode::add_entry (const string& entry_name, inode_t entry_type)
+{
+   inode *node = new inode (entry_type);
+   contents.dirents->insert (make_pair (entry_name, node));
+   dcache.invalidate (this, entry_name);
+   node->name = entry_name;
+   node->parent = this;
+   if (entry_type == DIR_INODE)
+   {
+      node->contents.dirents->insert (make_pair (".", node));
+      node->contents.dirents->insert (make_pair ("..", this));
+      node->path_length = path_length + 1 + entry_name.size();
+   }
+   return *node;
+}
+
+// Adds a dirent for an existing file, with no accounting;  the
+// image uses this for the second and later links to a file.
+void inode::add_link (const string& entry_name, inode& target)
+{
+   contents.dirents->insert (make_pair (entry_name, &target));
+   dcache.invalidate (this, entry_name);
+   ++target.links;
+   target.add_parent (this);
 }
 
 inode& inode::mkdir (const string& dirname)
 {
-   inode *dir = new inode (DIR_INODE);
-   dir->contents.dirents->insert (make_pair (".", dir));
-   dir->contents.dirents->insert (make_pair ("..", this));
-   contents.dirents->insert (make_pair (dirname, dir));
-   dir->name = dirname;
-   return *dir;
+   load_dirents();
+   check_quota (0, 1);
+   inode& dir = add_entry (dirname, DIR_INODE);
+   charge (0, 1);
+   history.entry_added (this, dirname, &dir);
+   return dir;
 }
 
 inode& inode::mkfile (const string& filename)
 {
-   inode *f = new inode (FILE_INODE);
-   contents.dirents->insert (make_pair (filename, f));
-   f->name = filename;
-   return *f;
+   load_dirents();
+   check_quota (0, 1);
+   inode& file = add_entry (filename, FILE_INODE);
+   charge (0, 1);
+   history.entry_added (this, filename, &file);
+   return file;
+}
+
+void inode::link (const string& filename, inode& target)
+{
+   load_dirents();
+   if (target.type != FILE_INODE)
+      throw yshell_exn ("link: can't link a directory");
+   check_quota (target.size(), 1);
+   if (not inserted (contents.dirents->insert (make_pair (filename,
+                                                           &target))))
+      throw yshell_exn ("link: " + filename + ": exists");
+   dcache.invalidate (this, filename);
+   ++target.links;
+   target.add_parent (this);
+   charge (target.size(), 1);
+   history.entry_added (this, filename, &target);
+}
+
+void inode::add_parent (inode* dir)
+{
+   if (parent == nullptr)
+   {
+      parent = dir;
+      return;
+   }
+   if (other_parents == nullptr)
+      other_parents.reset (new vector<inode*>);
+   other_parents->push_back (dir);
+}
+
+// Forgets one link from dir.
+void inode::drop_parent (inode* dir)
+{
+   vector<inode*>* others = other_parents.get();
+   if (others != nullptr and not others->empty())
+   {
+      auto found = find (others->begin(), others->end(), dir);
+      if (found == others->end())
+      {
+         // The first link is going;  another one takes its place.
+         found = others->end() - 1;
+         parent = *found;
+      }
+      *found = others->back();
+      others->pop_back();
+   }
+   else if (parent == dir)
+   {
+      parent = nullptr;
+   }
+}
+
+const uint64_t dir_quota::unlimited;
+size_t inode::quota_count {0};
+
+// Throws if adding bytes and inodes here would break a quota here
+// or above.  Nothing to do if there are no quotas at all.
+void inode::check_quota (int64_t bytes, int64_t inodes) const
+{
+   if (quota_count == 0 or (bytes <= 0 and inodes <= 0)) return;
+   for (const inode* up = this; ; up = up->parent)
+   {
+      const dir_quota* limits = up->quota.get();
+      if (limits != nullptr
+          and ((bytes > 0 and up->subtree_bytes + bytes > limits->bytes)
+               or (inodes > 0
+                   and up->subtree_inodes + inodes > limits->inodes)))
+         throw yshell_exn (up->get_path() + ": Disk quota exceeded");
+      if (up->parent == up) break;
+   }
+}
+
+// Adds to the totals here and in every directory above.
+void inode::charge (int64_t bytes, int64_t inodes)
+{
+   for (inode* up = this; ; up = up->parent)
+   {
+      up->subtree_bytes += bytes;
+      up->subtree_inodes += inodes;
+      if (up->parent == up) break;
+   }
+}
+
+// check_quota and charge for every directory linking a file.
+void inode::check_links (int64_t bytes) const
+{
+   if (parent == nullptr) return;
+   parent->check_quota (bytes, 0);
+   if (other_parents == nullptr) return;
+   for (inode* dir: *other_parents) dir->check_quota (bytes, 0);
+}
+
+void inode::charge_links (int64_t bytes)
+{
+   if (bytes == 0 or parent == nullptr) return;
+   parent->charge (bytes, 0);
+   if (other_parents == nullptr) return;
+   for (inode* dir: *other_parents) dir->charge (bytes, 0);
+}
+
+uint64_t inode::total_bytes() const
+{
+   return type == DIR_INODE ? subtree_bytes : size();
+}
+
+uint64_t inode::total_inodes() const
+{
+   return type == DIR_INODE ? subtree_inodes + 1 : 1;
+}
+
+void inode::set_quota (const dir_quota& limits)
+{
+   if (type != DIR_INODE)
+      throw yshell_exn ("set_quota called on FILE_INODE");
+   if (quota == nullptr) ++quota_count;
+   unique_ptr<dir_quota> old (move (quota));
+   quota.reset (new dir_quota (limits));
+   history.quota_replaced (this, move (old));
+}
+
+void inode::clear_quota()
+{
+   if (quota == nullptr) return;
+   --quota_count;
+   history.quota_replaced (this, move (quota));
 }
 
 string inode::get_name()
@@ -160,93 +404,238 @@ string inode::get_name()
 
 inode *inode::get_parent()
 {
-   if (type != DIR_INODE)
+   return parent;
+}
+
+string inode::get_path() const
+{
+   if (path_length == 0) return "/";
+   string path (path_length, '/');
+   size_t end = path_length;
+   for (const inode* dir = this;
+        dir->path_length > 0 and dir->parent != dir;
+        dir = dir->parent)
    {
-      return nullptr;
+      end -= dir->name.size();
+      path.replace (end, dir->name.size(), dir->name);
+      --end;
    }
-   directory *dir = contents.dirents;
-   return dir->at ("..");
+   return path;
 }
 
-directory inode::get_dirents()
+const directory& inode::get_dirents()
 {
+   load_dirents();
    return *(contents.dirents);
 }
 
-inode_state::inode_state() {
+void inode::load_dirents()
+{
+   if (image == nullptr) return;
+   const inode_image* from = image;
+   // Cleared first because loading calls mkdir and mkfile on us.
+   image = nullptr;
+   try {
+      from->load_dirents (this);
+   }catch (yshell_exn&) {
+      image = from;
+      throw;
+   }
+   history.mark_existing();
+}
+
+atomic<uint64_t> inode_tree::generation_ {0};
+
+inode_tree::inode_tree() {
    root = new inode (DIR_INODE);
    root->contents.dirents->insert (make_pair (".", root));
    root->contents.dirents->insert (make_pair ("..", root));
-   cwd = root;
-   
-   DEBUGF ('i', "root = " << (void*) root << ", cwd = " << (void*) cwd
-          << ", prompt = " << prompt);
+   root->parent = root;
+   pthread_rwlockattr_t attr;
+   pthread_rwlockattr_init (&attr);
+   pthread_rwlockattr_setkind_np (&attr,
+         PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+   pthread_rwlock_init (&rwlock, &attr);
+   pthread_rwlockattr_destroy (&attr);
+   DEBUGF ('i', "root = " << (void*) root);
 }
 
-inode_state::~inode_state()
+inode_tree::~inode_tree()
 {
-   recursive_delete (root);
+   inode::history.clear();
+   delete_tree (root);
    root = nullptr;
-   cwd = nullptr;
+   delete image;
+   pthread_rwlock_destroy (&rwlock);
 }
 
-void inode_state::recursive_delete(inode *node)
+void inode_tree::delete_tree (inode *node)
 {
-   if ((*node).get_type() == FILE_INODE)
+   bool freed_dir = false;
+   vector<inode*> pending {node};
+   while (not pending.empty())
    {
-      delete node;
-   }
-   else
-   {
-      //directory dir = *(((*node).contents).dirents);
-      directory *dir = node->contents.dirents;
-      dir->erase (".");
-      dir->erase ("..");
-      
-      for (auto i : *dir)
+      inode *curr = pending.back();
+      pending.pop_back();
+      if (curr->get_type() == DIR_INODE)
       {
-         inode *curr = i.second;
-         if ((*curr).get_type() == FILE_INODE)
-         {
-            delete curr;
-         }
-         else
-         {
-            recursive_delete (curr);
-         }
+         // Nothing needs to be unlinked from a directory that is
+         // going away, dot and dotdot included;  just free what it
+         // holds, in any order, so it is never sorted.
+         for_each_entry (*curr->contents.dirents,
+               [curr, &pending] (const directory::value_type& i) {
+                  if (i.first == "." || i.first == "..") return;
+                  if (i.second->type == FILE_INODE)
+                     i.second->drop_parent (curr);
+                  pending.push_back (i.second);
+               });
+         freed_dir = true;
       }
-      delete node;
+      else if (--curr->links > 0) continue;
+      delete curr;
    }
+   if (freed_dir) ++generation_;
+}
+
+void inode_tree::set_shared()
+{
+   shared = true;
+   dir_preorder (root);
+}
+
+void inode_tree::read_lock()
+{
+   pthread_rwlock_rdlock (&rwlock);
+}
+
+void inode_tree::write_lock()
+{
+   pthread_rwlock_wrlock (&rwlock);
+}
+
+void inode_tree::unlock()
+{
+   pthread_rwlock_unlock (&rwlock);
+}
+
+void inode_tree::save (const string& filename)
+{
+   inode_image::write (filename, root);
+}
+
+void inode_tree::load (const string& filename)
+{
+   // Map the new image before throwing away the old tree, so a
+   // bad file leaves everything alone.
+   inode_image* loaded = new inode_image (filename);
+   inode* loaded_root = new inode (DIR_INODE);
+   directory* dir = loaded_root->contents.dirents;
+   dir->insert (make_pair (".", loaded_root));
+   dir->insert (make_pair ("..", loaded_root));
+   loaded_root->parent = loaded_root;
+   try {
+      loaded_root->image_rec = loaded->root();
+      loaded_root->image = loaded;
+      loaded->read_totals (loaded_root);
+      if (loaded->has_links()) loaded->load_all (loaded_root);
+      else if (shared) dir_preorder (loaded_root);
+   }catch (yshell_exn&) {
+      delete_tree (loaded_root);
+      delete loaded;
+      throw;
+   }
+   inode::history.clear();
+   delete_tree (root);
+   delete image;
+   root = loaded_root;
+   image = loaded;
+}
+
+tree_history& inode_tree::history()
+{
+   return inode::history;
+}
+
+inode_state::inode_state (inode_tree& tree):
+   tree (tree), cwd (tree.get_root()),
+   generation_seen (inode_tree::generation())
+{
+   DEBUGF ('i', "root = " << (void*) tree.get_root()
+          << ", cwd = " << (void*) cwd << ", prompt = " << prompt);
 }
 
 ostream& operator<< (ostream& out, const inode_state& state) {
-   out << "inode_state: root = " << state.root
+   out << "inode_state: root = " << state.tree.get_root()
        << ", cwd = " << state.cwd;
    return out;
 }
 
 // Pre: path.size >= 1
+// Walks the path in place instead of splitting it, reusing one
+// buffer for the component being looked up.
 inode *inode_state::inode_from_path (const string &path)
 {
-   wordvec dirs = split (path, "/");
    inode *curr = cwd;
    if (path.at (0) == '/')
    {
-      curr = root;
+      curr = tree.get_root();
    }
    
-   for (auto& i : dirs)
+   bool shared = tree.is_shared();
+   string component;
+   size_t end = 0;
+   for (;;)
    {
+      size_t start = path.find_first_not_of ('/', end);
+      if (start == string::npos) break;
+      end = path.find ('/', start);
+      component.assign (path, start, end - start);
       if ((*curr).get_type() != DIR_INODE)
          throw yshell_exn ("invalid path");
-      directory *d = curr->contents.dirents;
-      if (d->count (i) == 0)
+      if (shared)
+      {
+         const directory& dirents = *curr->contents.dirents;
+         auto found = dirents.find (component);
+         curr = found == dirents.end() ? nullptr : found->second;
+      }
+      else
+      {
+         curr = inode::dcache.lookup (curr, component);
+      }
+      if (curr == nullptr)
          return nullptr;
-      curr = d->at (i);
    }
    return curr;
 }
 
+void inode_state::save (const string& filename)
+{
+   tree.save (filename);
+}
+
+void inode_state::load (const string& filename)
+{
+   tree.load (filename);
+   set_cwd (tree.get_root());
+}
+
+bool inode_state::check_cwd()
+{
+   uint64_t generation = inode_tree::generation();
+   if (generation == generation_seen) return true;
+   generation_seen = generation;
+   string path = cwd_path;
+   cwd = tree.get_root();
+   inode* found = inode_from_path (path);
+   if (found == nullptr or found->get_type() != DIR_INODE)
+   {
+      set_cwd (tree.get_root());
+      return false;
+   }
+   set_cwd (found);
+   return true;
+}
+
 string inode_state::get_prompt()
 {
    return prompt;
@@ -264,10 +653,22 @@ inode *inode_state::get_cwd()
 
 inode *inode_state::get_root()
 {
-   return root;
+   return tree.get_root();
 }
 
 void inode_state::set_cwd (inode *c)
 {
    cwd = c;
+   cwd_path_valid = false;
+   if (tree.is_shared()) get_cwd_path();
+}
+
+const string& inode_state::get_cwd_path()
+{
+   if (not cwd_path_valid)
+   {
+      cwd_path = cwd->get_path();
+      cwd_path_valid = true;
+   }
+   return cwd_path;
 }
@@ -4,13 +4,20 @@
 #ifndef __INODE_H__
 #define __INODE_H__
 
+#include <atomic>
+#include <cstdint>
 #include <exception>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
+#include <pthread.h>
 
 using namespace std;
 
+#include "blob.h"
+#include "dcache.h"
+#include "dirmap.h"
 #include "util.h"
 
 //
@@ -24,42 +31,140 @@ enum inode_t {DIR_INODE, FILE_INODE};
 // directory -
 //    A directory is a list of paired strings (filenames) and inodes.
 //    An inode in a directory may be a directory or a file.
+//    By default it is a dirmap, a flat hash table;  compile with
+//    -DMAP_DIRECTORY to use a std::map instead.
 //
 
 class inode;
+class inode_image;
+class tree_history;
+#ifdef MAP_DIRECTORY
 typedef map<string, inode*> directory;
+#else
+typedef dirmap<inode*> directory;
+#endif
+
+//
+// dir_quota -
+//    Limits on the bytes and inodes under a directory, counted the
+//    way du counts them.  unlimited means no limit on that one.
+//
+
+struct dir_quota {
+   static const uint64_t unlimited = UINT64_MAX;
+   uint64_t bytes;
+   uint64_t inodes;
+};
+
+//
+// inode_tree -
+//    The tree itself:  the root (/) and the image it may still be
+//    reading from.  In server mode every session shares one.
+// save -
+//    Writes the whole tree to an image file.
+// load -
+//    Replaces the tree with the one in an image file.  The image
+//    stays mapped, and directories are read from it on first use.
+// delete_tree -
+//    Frees node and everything under it, using an explicit stack
+//    rather than recursion.  A file that is still linked from
+//    somewhere else just loses a link.
+// set_shared -
+//    From here on many threads read the tree at once, holding
+//    read_lock, so reading must change nothing:  a loaded image is
+//    read in completely rather than a directory at a time, and
+//    path lookups go to the directories instead of the dentry
+//    cache.
+// read_lock/write_lock/unlock -
+//    The tree's reader-writer lock.  Waiting writers go ahead of
+//    new readers, so a stream of ls can't hold off a mkdir.
+// generation -
+//    Counts the calls to delete_tree that freed a directory, and
+//    the directories the history has detached, so a session can
+//    tell when its cwd may have gone.
+// history -
+//    The log undo, redo, snapshot and rollback work from.  load
+//    clears it.
+//
+
+class inode_tree {
+   friend class tree_history;
+   private:
+      inode_tree (const inode_tree&) = delete;
+      inode_tree& operator= (const inode_tree&) = delete;
+      inode* root {nullptr};
+      inode_image* image {nullptr};
+      bool shared {false};
+      pthread_rwlock_t rwlock;
+      static atomic<uint64_t> generation_;
+   public:
+      inode_tree();
+      ~inode_tree();
+      inode* get_root() { return root; }
+      bool is_shared() const { return shared; }
+      void set_shared();
+      void save (const string& filename);
+      void load (const string& filename);
+      static void delete_tree (inode *node);
+      void read_lock();
+      void write_lock();
+      void unlock();
+      static uint64_t generation() { return generation_.load(); }
+      tree_history& history();
+};
 
 //
 // inode_state -
 //    A small convenient class to maintain the state of the simulated
-//    process:  the root (/), the current directory (.), and the
-//    prompt.
+//    process:  the tree, the current directory (.), the prompt,
+//    and where command output goes.  Each server session has one.
+// save/load -
+//    Forwarded to the tree;  load also moves cwd to the new root.
+// get_cwd_path -
+//    The path of cwd, worked out on the first call after a cd and
+//    then kept.
+// check_cwd -
+//    In a shared tree, finds cwd again by its path if a directory
+//    has been deleted since the last call.  If it is gone, cwd
+//    becomes the root and false is returned.
+// history -
+//    The tree's history.
 //
 
 class inode_state {
-   friend class inode;
    friend ostream& operator<< (ostream& out, const inode_state&);
    private:
       inode_state (const inode_state&) = delete; // copy ctor
       
       inode_state& operator= (const inode_state&) = delete; // op=
-      inode* root {nullptr};
+      inode_tree& tree;
       inode* cwd {nullptr};
+      ostream* out {&cout};
+      // Worked out when asked for, or at every cd in a shared
+      // tree, where check_cwd needs it after cwd may have gone.
+      string cwd_path {"/"};
+      bool cwd_path_valid {true};
+      uint64_t generation_seen {0};
       
       
       
       // fields
       string prompt {"% "};
    public:
-      inode_state();
-      ~inode_state (); // Destructor
+      explicit inode_state (inode_tree& tree);
       inode *inode_from_path (const string &path);
       string get_prompt();
       void set_prompt(const string &p);
       inode *get_cwd();
       inode *get_root();
       void set_cwd(inode *c);
-      static void recursive_delete (inode *node);
+      const string& get_cwd_path();
+      ostream& output() { return *out; }
+      void set_output (ostream& stream) { out = &stream; }
+      void save (const string& filename);
+      void load (const string& filename);
+      bool check_cwd();
+      tree_history& history() { return tree.history(); }
 };
 
 ostream& operator<< (ostream& out, const inode_state&);
@@ -75,20 +180,41 @@ ostream& operator<< (ostream& out, const inode_state&);
 //    allocated in sequence by small integer.
 // size -
 //    Returns the size of an inode.  For a directory, this is the
-//    number of dirents.  For a text file, the number of characters
-//    when printed (the sum of the lengths of each word, plus the
-//    number of words.
+//    number of dirents.  For a text file, the number of bytes,
+//    which is kept with the data rather than counted.
+// empty -
+//    True for a directory holding only dot and dotdot.
+// get_dirents -
+//    The directory's entries, by reference.  Iterating it visits
+//    them in name order.
+// get_parent -
+//    A directory's parent, kept in the inode rather than looked up
+//    as dotdot.  The root is its own parent.  For a file, the
+//    directory holding its first link.
+// get_path -
+//    A directory's full path.  Directories never move, so each
+//    keeps the length of its path from the day it is made, and the
+//    path is written into a string of exactly that size, from the
+//    end back, while walking up the parents.  A directory the
+//    history has detached is its own parent until it is put
+//    back, and its path is not to be relied on meanwhile.
 // readfile -
-//    Returns a copy of the contents of the wordvec in the file.
+//    Returns the bytes of the file, in one contiguous string.
 //    Throws an yshell_exn for a directory.
 // writefile -
 //    Replaces the contents of a file with new contents.
 //    Throws an yshell_exn for a directory.
+// share_contents -
+//    Gives this file the same contents as another, without
+//    copying them.
 // remove -
 //    Removes the file or subdirectory from the current inode.
 //    Throws an yshell_exn if this is not a directory, the file
 //    does not exist, or the subdirectory is not empty.
 //    Here empty means the only entries are dot (.) and dotdot (..).
+//    What is removed goes to the history, which frees it once it
+//    can no longer be undone.  A file is only freed when its last
+//    link is gone.
 // mkdir -
 //    Creates a new directory under the current directory and 
 //    immediately adds the directories dot (.) and dotdot (..) to it.
@@ -97,37 +223,118 @@ ostream& operator<< (ostream& out, const inode_state&);
 // mkfile -
 //    Create a new empty text file with the given name.  Error if
 //    a dirent with that name exists.
+// link -
+//    Adds a dirent for an existing file (a hard link), which then
+//    has one more link.  Directories can't be linked.  Throws an
+//    yshell_exn if a dirent with that name exists.
+// total_bytes/total_inodes -
+//    What du reports.  For a directory, the bytes in every file
+//    under it and the number of inodes under it and itself;  a
+//    file is counted once for each link.  For a file, its size
+//    and 1.  Each directory keeps its totals up to date as things
+//    change under it, so these are O(1).  Every change
+//    adds the difference to the directory it happens in and each
+//    directory above it, and a change to a file's contents does
+//    so for each directory linking it.
+// set_quota/clear_quota/get_quota -
+//    A directory's quota.  A change that would take the totals of
+//    any directory above it past its quota throws yshell_exn
+//    before anything is changed.  Totals already past a new quota
+//    are left alone;  they just can't grow.
+// check_quota -
+//    Throws yshell_exn if adding bytes and inodes under this
+//    directory would break a quota.  A command that makes several
+//    changes checks all of them with it before it makes the first.
+// operator new/delete -
+//    Inodes come from a slab_pool, as do their directories, so a
+//    tree's inodes are packed together and freeing a subtree is a
+//    push onto a free list per inode.  A file's contents are a
+//    blob, shared with every other file holding the same bytes.
+// load_dirents -
+//    A directory that came from an image is only a stub holding
+//    dot and dotdot until this reads the rest of its entries.
+//    Everything that looks inside a directory calls it first.
 //    
 
 
 class inode {
    friend class inode_state;
+   friend class inode_tree;
+   friend class inode_image;
+   friend class dentry_cache;
+   friend class tree_history;
    private:
       int inode_nr;
       inode_t type;
       union {
          directory* dirents;
-         wordvec* data;
+         blob* data;
       } contents;
+      // Number of dirents naming this inode, and of removed ones
+      // the history still holds;  always 1 for a directory, whose
+      // dot and dotdot are not counted.
+      size_t links {1};
       static int next_inode_nr;
+      static dentry_cache dcache;
+      static tree_history history;
       // filename of inode
       string name;
+      // Set while a directory's entries are still in the image
+      const inode_image* image {nullptr};
+      uint64_t image_rec {0};
+      // For a file, the directory holding its first link, with
+      // the rest in other_parents.  path_length is for directories
+      // only, and 0 for the root.
+      inode* parent {nullptr};
+      unique_ptr<vector<inode*>> other_parents;
+      size_t path_length {0};
+      // Directories only:  totals for everything under this one,
+      // and the limits on them, if any.
+      uint64_t subtree_bytes {0};
+      uint64_t subtree_inodes {0};
+      unique_ptr<dir_quota> quota;
+      static size_t quota_count;
+      void load_dirents();
+      inode& add_entry (const string& name, inode_t entry_type);
+      void add_link (const string& name, inode& target);
+      void replace_data (blob* newdata);
+      void change_data (blob* newdata);
+      void detach (const string& name, inode* node);
+      void attach (const string& name, inode* node);
+      void add_parent (inode* dir);
+      void drop_parent (inode* dir);
+      void charge (int64_t bytes, int64_t inodes);
+      void check_links (int64_t bytes) const;
+      void charge_links (int64_t bytes);
    public:
       inode (inode_t init_type);
-      inode (const inode& source);
+      inode (const inode& source) = delete;
       ~inode (); // Destructor. Used to clean up allocated memory
-      inode& operator= (const inode& from);
+      inode& operator= (const inode& from) = delete;
+      static void* operator new (size_t size);
+      static void operator delete (void* where);
       int get_inode_nr() const;
       inode_t get_type() const;
       int size() const;
-      const wordvec& readfile() const;
-      void writefile (const wordvec& newdata);
+      bool empty() const;
+      const string& readfile() const;
+      void writefile (const string& newdata);
+      void writefile (string&& newdata);
+      void share_contents (const inode& from);
       void remove (const string& filename);
       inode& mkdir (const string& dirname);
       inode& mkfile (const string& filename);
+      void link (const string& filename, inode& target);
       string get_name();
       inode *get_parent();
-      directory get_dirents();
+      string get_path() const;
+      const directory& get_dirents();
+      uint64_t total_bytes() const;
+      uint64_t total_inodes() const;
+      const dir_quota* get_quota() const { return quota.get(); }
+      void set_quota (const dir_quota& limits);
+      void clear_quota();
+      void check_quota (int64_t bytes, int64_t inodes) const;
 };
 
 #endif
@@ -0,0 +1,331 @@
+// $Id: journal.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "history.h"
+#include "journal.h"
+
+journal* journal::active = nullptr;
+constexpr chrono::milliseconds journal::commit_interval;
+
+// The usual reflected CRC-32 (polynomial 0xEDB88320).
+static uint32_t crc32 (const char* bytes, size_t count)
+{
+   static uint32_t table[256];
+   static bool ready = false;
+   if (not ready)
+   {
+      for (uint32_t index = 0; index < 256; ++index)
+      {
+         uint32_t crc = index;
+         for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+         table[index] = crc;
+      }
+      ready = true;
+   }
+   uint32_t crc = 0xFFFFFFFF;
+   for (size_t index = 0; index < count; ++index)
+   {
+      crc = table[(crc ^ uint8_t (bytes[index])) & 0xFF] ^ (crc >> 8);
+   }
+   return crc ^ 0xFFFFFFFF;
+}
+
+static void put_uint32 (string& out, uint32_t value)
+{
+   out.append (reinterpret_cast<const char*> (&value), sizeof value);
+}
+
+static void put_string (string& out, const string& text)
+{
+   put_uint32 (out, text.size());
+   out += text;
+}
+
+static uint32_t get_uint32 (const char* where)
+{
+   uint32_t value;
+   memcpy (&value, where, sizeof value);
+   return value;
+}
+
+static void sync_dir (const string& dir)
+{
+   int dir_fd = open (dir.c_str(), O_RDONLY | O_DIRECTORY);
+   if (dir_fd < 0) return;
+   fsync (dir_fd);
+   close (dir_fd);
+}
+
+static void write_all (int fd, const string& bytes)
+{
+   for (size_t done = 0; done < bytes.size(); )
+   {
+      ssize_t count = write (fd, bytes.data() + done,
+                             bytes.size() - done);
+      if (count < 0 and errno == EINTR) continue;
+      if (count < 0)
+         throw yshell_exn (string ("journal: ") + strerror (errno));
+      done += count;
+   }
+}
+
+journal::journal (const string& dir, commands& cmdmap,
+                  inode_tree& tree):
+   dir (dir), cmdmap (cmdmap), tree (tree)
+{
+   if (mkdir (dir.c_str(), 0777) < 0 and errno != EEXIST)
+      throw yshell_exn (dir + ": " + strerror (errno));
+   recover();
+   active = this;
+   flusher = thread (&journal::flush_loop, this);
+}
+
+journal::~journal()
+{
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   flushed.notify_all();
+   flusher.join();
+   sync();
+   close (fd);
+   active = nullptr;
+}
+
+string journal::file (const string& kind, uint64_t gen) const
+{
+   return dir + "/" + kind + "." + to_string (gen);
+}
+
+//
+// recover -
+//    Finds the newest checkpoint, loads it, replays its journal,
+//    and opens that journal for appending.  Files from older
+//    generations, and any left half written, are removed.
+//
+void journal::recover()
+{
+   DIR* listing = opendir (dir.c_str());
+   if (listing == nullptr)
+      throw yshell_exn (dir + ": " + strerror (errno));
+   vector<string> names;
+   while (dirent* entry = readdir (listing))
+      names.push_back (entry->d_name);
+   closedir (listing);
+
+   auto generation_of = [] (const string& name, const string& kind,
+                            uint64_t& gen) {
+      string prefix = kind + ".";
+      if (name.compare (0, prefix.size(), prefix) != 0) return false;
+      string digits = name.substr (prefix.size());
+      if (digits.empty()
+          or digits.find_first_not_of ("0123456789") != string::npos)
+         return false;
+      gen = stoull (digits);
+      return true;
+   };
+   for (const auto& name: names)
+   {
+      uint64_t gen;
+      if (generation_of (name, "checkpoint", gen) and gen > generation)
+         generation = gen;
+   }
+   for (const auto& name: names)
+   {
+      uint64_t gen;
+      bool stale = (generation_of (name, "checkpoint", gen)
+                    or generation_of (name, "journal", gen))
+                   and gen < generation;
+      bool unfinished = name.compare (0, 11, "checkpoint.") == 0
+                        and name.find (".tmp") != string::npos;
+      if (stale or unfinished)
+      {
+         DEBUGF ('j', "removing " << name);
+         unlink ((dir + "/" + name).c_str());
+      }
+   }
+
+   if (generation > 0) tree.load (file ("checkpoint", generation));
+   string log = file ("journal", generation);
+   size_t good = replay (log);
+   fd = open (log.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+   if (fd < 0)
+      throw yshell_exn (log + ": " + strerror (errno));
+   if (ftruncate (fd, good) < 0)
+      throw yshell_exn (log + ": " + strerror (errno));
+   logged_bytes = good;
+   sync_dir (dir);
+}
+
+// Replays every whole record in log and returns the number of
+// bytes they take up.  Output from the commands is thrown away.
+size_t journal::replay (const string& log)
+{
+   ifstream in (log, ios::binary);
+   if (not in) return 0;
+   stringstream contents;
+   contents << in.rdbuf();
+   const string bytes = contents.str();
+
+   ostream discard (nullptr);
+   inode_state state (tree);
+   state.set_output (discard);
+   size_t pos = 0, records = 0;
+   wordvec words;
+   while (bytes.size() - pos >= 8)
+   {
+      uint32_t length = get_uint32 (&bytes[pos]);
+      uint32_t crc = get_uint32 (&bytes[pos + 4]);
+      if (length > bytes.size() - pos - 8) break;
+      const char* record = &bytes[pos + 8];
+      if (crc32 (record, length) != crc) break;
+
+      // The cwd, then the words.
+      words.clear();
+      for (size_t offset = 0; offset + 4 <= length; )
+      {
+         uint32_t size = get_uint32 (record + offset);
+         offset += 4;
+         if (size > length - offset) break;
+         words.emplace_back (record + offset, size);
+         offset += size;
+      }
+      pos += 8 + length;
+      ++records;
+      if (words.size() < 2) continue;
+      inode* cwd = state.inode_from_path (words[0]);
+      function fn = cmdmap.find (words[1]);
+      words.erase (words.begin());
+      try {
+         if (cwd == nullptr or fn == nullptr)
+            throw yshell_exn ("can't replay " + words[0]);
+         state.set_cwd (cwd);
+         state.history().begin_command();
+         try {
+            fn (state, words);
+         }catch (yshell_exn&) {
+            state.history().abort_command();
+            throw;
+         }
+         state.history().end_command();
+      }catch (yshell_exn& exn) {
+         complain() << log << ": " << exn.what() << endl;
+      }
+   }
+   if (pos < bytes.size())
+      DEBUGF ('j', log << ": dropping " << bytes.size() - pos
+              << " bytes of torn record");
+   DEBUGF ('j', log << ": replayed " << records << " records");
+   return pos;
+}
+
+void journal::record (inode_state& state, const wordvec& words)
+{
+   if (active == nullptr or words.empty()) return;
+   if (words[0] == "load" or words[0] == "import")
+      active->checkpoint();
+   else if (words[0] != "save" and words[0] != "export"
+            and not active->cmdmap.reads_only (words[0]))
+      active->append (state, words);
+}
+
+void journal::append (inode_state& state, const wordvec& words)
+{
+   string body;
+   put_string (body, state.get_cwd_path());
+   for (const auto& word: words) put_string (body, word);
+   {
+      lock_guard<mutex> guard (lock);
+      put_uint32 (pending, body.size());
+      put_uint32 (pending, crc32 (body.data(), body.size()));
+      pending += body;
+   }
+   logged_bytes += 8 + body.size();
+   if (logged_bytes >= checkpoint_bytes) checkpoint();
+}
+
+// Every commit_interval, writes and syncs whatever has collected.
+// Commands keep appending to a fresh buffer meanwhile.
+void journal::flush_loop()
+{
+   string writing;
+   unique_lock<mutex> guard (lock);
+   while (not stopping)
+   {
+      flushed.wait_for (guard, commit_interval);
+      if (pending.empty()) continue;
+      writing.swap (pending);
+      flushing = true;
+      guard.unlock();
+      try {
+         write_all (fd, writing);
+         fdatasync (fd);
+      }catch (yshell_exn& exn) {
+         complain() << exn.what() << endl;
+      }
+      guard.lock();
+      writing.clear();
+      flushing = false;
+      flushed.notify_all();
+   }
+}
+
+// Writes and syncs everything logged so far, now.
+void journal::sync()
+{
+   unique_lock<mutex> guard (lock);
+   flushed.wait (guard, [this] { return not flushing; });
+   write_all (fd, pending);
+   pending.clear();
+   fdatasync (fd);
+}
+
+//
+// checkpoint -
+//    Saves the tree as the next generation's checkpoint and starts
+//    its empty journal.  The image is complete once it has been
+//    renamed into place, and from then on recovery starts there;
+//    until then it starts from the old generation, whose files
+//    are only removed afterward.
+//
+void journal::checkpoint()
+{
+   sync();
+   tree.history().clear();
+   uint64_t next = generation + 1;
+   tree.save (file ("checkpoint", next));
+   string log = file ("journal", next);
+   int next_fd = open (log.c_str(),
+                       O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
+   if (next_fd < 0)
+      throw yshell_exn (log + ": " + strerror (errno));
+   sync_dir (dir);
+   {
+      lock_guard<mutex> guard (lock);
+      close (fd);
+      fd = next_fd;
+   }
+   unlink (file ("journal", generation).c_str());
+   unlink (file ("checkpoint", generation).c_str());
+   sync_dir (dir);
+   generation = next;
+   logged_bytes = 0;
+   DEBUGF ('j', "checkpoint " << generation);
+}
+
@@ -0,0 +1,94 @@
+// $Id: journal.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+#include "commands.h"
+#include "inode.h"
+
+//
+// journal -
+//    Keeps the tree across restarts (-j dir).  Each command that
+//    changes the tree is logged after it succeeds, as the cwd it
+//    ran in and its words.  Replaying the log in order on top of
+//    the last checkpoint rebuilds the tree.
+//
+//    Records are group committed.  Logging a command only copies
+//    it into a buffer.  A background thread writes whatever has
+//    collected and fsyncs it once per commit_interval, so one
+//    fsync covers every command in the interval.  A crash loses
+//    at most the last interval.  Exiting syncs everything.
+//
+//    When the log passes checkpoint_bytes, or after a load or an
+//    import (whose source may change before a replay), the tree
+//    is saved as an image and a new, empty log is started.
+//    Recovery then only replays what came after that.  The undo
+//    history is cleared too, as a replay starts without one, so
+//    that undo and rollback replay the way they first ran.
+//
+//    Files in dir, for the current generation G:
+//       checkpoint.G   image of the tree when journal.G began
+//                      (none for generation 0, the empty tree)
+//       journal.G      records since then
+//    A record is uint32 length, uint32 crc32, then the cwd and
+//    each word as uint32 length and bytes.  Recovery stops at the
+//    first record that is short or fails its crc, and cuts the
+//    file there, so a record torn by a crash is dropped.
+//
+// ctor -
+//    Opens or creates dir and recovers the tree from it.  Throws
+//    yshell_exn if the directory or its files can't be used.
+// record -
+//    Logs words if the command changes the tree, and checkpoints
+//    after load and import.  Does nothing unless a journal is
+//    open.  Call it only after the command succeeded, and in
+//    server mode while still holding the write lock, so the log
+//    order is the order the commands took effect.  A command that
+//    failed has been taken back whole by run_command, so leaving
+//    it out of the log loses nothing.
+//
+
+class journal {
+   private:
+      journal (const journal&) = delete;
+      journal& operator= (const journal&) = delete;
+      static const size_t checkpoint_bytes = 64 << 20;
+      static constexpr chrono::milliseconds commit_interval {10};
+      static journal* active;
+      const string dir;
+      commands& cmdmap;
+      inode_tree& tree;
+      uint64_t generation {0};
+      int fd {-1};
+      size_t logged_bytes {0};
+      mutex lock;
+      condition_variable flushed;
+      string pending;
+      bool flushing {false};
+      bool stopping {false};
+      thread flusher;
+      string file (const string& kind, uint64_t gen) const;
+      void recover();
+      size_t replay (const string& log);
+      void flush_loop();
+      void sync();
+      void checkpoint();
+      void append (inode_state& state, const wordvec& words);
+   public:
+      journal (const string& dir, commands& cmdmap, inode_tree& tree);
+      ~journal();
+      static void record (inode_state& state, const wordvec& words);
+};
+
+#endif
+
@@ -0,0 +1,138 @@
+#!/bin/sh
+# $Id: journaltest.sh,v 1.1 2014-04-09 17:04:58-07 - - $
+# Author: Coy Humphrey (cmhumphr)
+
+#
+# journaltest.sh -
+#    Restart tests for the journal (-j).  Each test runs one set of
+#    commands in a yshell with a new journal, and a second set in
+#    another yshell that recovers from it.  What the second prints
+#    must match what one yshell with no journal prints when it runs
+#    the first set, less its saves and loads, goes back to /, and
+#    then runs the second.  So a checkpoint must give back the tree
+#    just as it was.  Inode numbers are not compared, since loading
+#    a checkpoint numbers inodes afresh.
+#
+#    Usage:  sh journaltest.sh yshell
+#    Exits 1 if any test fails.  Run by "make test".
+#
+
+yshell=${1:?usage: $0 yshell}
+case $yshell in /*) ;; *) yshell=`pwd`/$yshell;; esac
+tmp=`mktemp -d` || exit 1
+trap 'rm -rf "$tmp"' 0
+cd "$tmp" || exit 1
+failed=0
+
+# What yshell prints, less its banner and exit status, and with the
+# inode number cut from the front of each line ls prints.
+clean() {
+   sed -e 1d -e '/: exit([0-9]*)$/d' -e 's/^ *[0-9][0-9]* //'
+}
+
+# check name first second
+check() {
+   rm -rf journal expected
+   printf '%s\n' "$2" | "$yshell" -j journal >/dev/null 2>&1
+   printf '%s\n' "$3" | "$yshell" -j journal 2>&1 | clean >actual
+   printf '%s\ncd /\n# restart\n%s\n' "$2" "$3" \
+      | sed -e '/^save /d' -e '/^load /d' \
+      | "$yshell" 2>&1 | clean | sed '1,/^% # restart$/d' >expected
+   if cmp -s expected actual; then
+      echo "$1: ok"
+   else
+      echo "$1: FAILED"
+      diff expected actual
+      failed=1
+   fi
+}
+
+mkdir host host/sub
+for nr in 1 2 3 4 5 6; do
+   echo "host file $nr" >host/f$nr
+   echo $nr >host/sub/g$nr
+done
+
+check "cwd after a checkpoint" "
+mkdir a
+save image
+load image
+mkdir b" "
+pwd
+ls
+mkdir c
+lsr /"
+
+check "cwd after an import" "
+mkdir a
+cd a
+import $tmp/host h" "
+pwd
+ls
+mkdir c
+lsr /"
+
+check "failed commands" "
+mkdir /q
+quota /q 5 100
+make /q/f hello world
+quota /q 50 100
+make /q/keep kept
+import $tmp/host /q/h
+undo
+make /q/f hello world
+redo" "
+lsr /
+du /q
+undo
+lsr /"
+
+check "hard links in a checkpoint" "
+make g hello
+ln g h
+mkdir d
+ln g d/k
+save image
+load image
+make g again
+rm h" "
+cat g
+cat d/k
+lsr /
+du /
+rm g
+make d/k once more
+cat d/k
+lsr /"
+
+check "undo and redo" "
+mkdir a
+make a/f one
+make a/g two
+ln a/f h
+undo
+redo
+rm a/g
+snapshot s
+mkdir b
+cp a b/c
+undo
+make a/f changed
+rollback s
+redo
+mkdir z
+cd a
+make x in a
+undo
+quota /z 10 10
+make /z/big far too long for z
+undo" "
+lsr /
+du /
+undo
+lsr /
+redo
+redo
+lsr /"
+
+exit $failed
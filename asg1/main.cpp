@@ -3,31 +3,60 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
 #include <unistd.h>
 
 using namespace std;
 
+#include "batch.h"
 #include "commands.h"
 #include "debug.h"
 #include "inode.h"
+#include "journal.h"
+#include "server.h"
+#include "stats.h"
 #include "util.h"
 
 //
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:  -@flags sets debug flags, -f script runs
+//    script in batch mode instead of reading cin, -s socket
+//    serves clients on a UNIX socket instead, -j dir keeps the
+//    tree in dir across runs, and -S file records command stats
+//    and writes them to file at exit.
 //
 
-void scan_options (int argc, char** argv) {
+struct options {
+   string script;
+   string socket;
+   string journal_dir;
+   string stats_file;
+};
+
+options scan_options (int argc, char** argv) {
+   options result;
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:f:j:s:S:");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'f':
+            result.script = optarg;
+            break;
+         case 'j':
+            result.journal_dir = optarg;
+            break;
+         case 's':
+            result.socket = optarg;
+            break;
+         case 'S':
+            result.stats_file = optarg;
+            break;
          default:
             complain() << "-" << (char) option << ": invalid option"
                        << endl;
@@ -37,6 +66,7 @@ void scan_options (int argc, char** argv) {
    if (optind < argc) {
       complain() << "operands not permitted" << endl;
    }
+   return result;
 }
 
 
@@ -50,12 +80,43 @@ int main (int argc, char** argv) {
    cout << boolalpha; // Print false or true instead of 0 or 1.
    cerr << boolalpha;
    cout << argv[0] << " build " << __DATE__ << " " << __TIME__ << endl;
-   scan_options (argc, argv);
+   options opts = scan_options (argc, argv);
+   if (opts.stats_file.size() > 0)
+      command_stats::set_dump_file (opts.stats_file);
    bool need_echo = want_echo();
    commands cmdmap;
-   inode_state state;
+   // The tree is never freed:  the system takes it all back at exit
+   // far faster than delete_tree could give it back inode by inode.
+   inode_tree& tree = *new inode_tree;
+   unique_ptr<journal> log;
+   if (opts.journal_dir.size() > 0) {
+      try {
+         log.reset (new journal (opts.journal_dir, cmdmap, tree));
+      }catch (yshell_exn& exn) {
+         complain() << exn.what() << endl;
+         return exit_status_message();
+      }
+   }
+   // Only now, since recovering may load a checkpoint, which
+   // replaces the root a state made earlier would be left in.
+   inode_state state (tree);
    try {
-      for (;;) {
+      if (opts.socket.size() > 0) {
+         try {
+            serve (opts.socket, cmdmap, tree);
+         }catch (yshell_exn& exn) {
+            complain() << exn.what() << endl;
+         }
+      }
+      else if (opts.script.size() > 0) {
+         try {
+            batch_script batch (opts.script, cmdmap);
+            batch.run (state);
+         }catch (yshell_exn& exn) {
+            complain() << exn.what() << endl;
+         }
+      }
+      else for (;;) {
          try {
    
             // Read a line, break at EOF, and echo print the prompt
@@ -78,8 +139,7 @@ int main (int argc, char** argv) {
             // If the line is empty or starts with a '#' ignore it
             if (words.size() == 0 || (words.at(0).front() == '#'))
                continue;
-            function fn = cmdmap.at(words.at(0));
-            fn (state, words);
+            run_command (state, cmdmap, words);
          }catch (yshell_exn& exn) {
             // If there is a problem discovered in any function, an
             // exn is thrown and printed here.
@@ -89,6 +149,7 @@ int main (int argc, char** argv) {
    } catch (ysh_exit_exn& ) {
       // This catch intentionally left blank.
    }
+   command_stats::dump();
 
    return exit_status_message();
 }
@@ -0,0 +1,98 @@
+// $Id: pool.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//
+// slab_pool -
+//    Hands out blocks of one size class, carved from slabs of
+//    slab_blocks blocks each, so objects of similar size end up
+//    next to each other.  A released block goes on a free list
+//    and is handed out again before a new slab is started; slabs
+//    are only given back when the pool itself goes away.
+//    There is no bulk free:  deleting a subtree releases its
+//    objects one at a time, each a push onto the free list, and
+//    the slabs they were in stay with the pool.
+//    Not thread safe.
+//
+// size_class -
+//    The pool for objects of size bytes, rounded up to a multiple
+//    of 16.  Types whose sizes round the same share one pool.
+// pool_new/pool_delete -
+//    Like new and delete, but for the size class pools.
+//
+
+template <size_t block_size>
+class slab_pool {
+   private:
+      slab_pool (const slab_pool&) = delete;
+      slab_pool& operator= (const slab_pool&) = delete;
+      union block {
+         block* next;
+         max_align_t align;
+         char storage[block_size];
+      };
+      static const size_t slab_blocks = 4096;
+      vector<block*> slabs;
+      block* free_list {nullptr};
+   public:
+      slab_pool() {}
+      ~slab_pool() {
+         for (block* slab: slabs) delete[] slab;
+      }
+      void* allocate() {
+         if (free_list == nullptr)
+         {
+            block* slab = new block[slab_blocks];
+            slabs.push_back (slab);
+            for (size_t index = slab_blocks; index > 0; --index)
+            {
+               slab[index - 1].next = free_list;
+               free_list = &slab[index - 1];
+            }
+         }
+         block* result = free_list;
+         free_list = free_list->next;
+         return result;
+      }
+      void release (void* where) {
+         block* freed = static_cast<block*> (where);
+         freed->next = free_list;
+         free_list = freed;
+      }
+};
+
+template <size_t size>
+slab_pool<(size + 15) / 16 * 16>& size_class() {
+   static slab_pool<(size + 15) / 16 * 16> pool;
+   return pool;
+}
+
+template <typename T, typename... Args>
+T* pool_new (Args&&... args) {
+   void* where = size_class<sizeof (T)>().allocate();
+   try {
+      return new (where) T (forward<Args> (args)...);
+   }catch (...) {
+      size_class<sizeof (T)>().release (where);
+      throw;
+   }
+}
+
+template <typename T>
+void pool_delete (T* object) {
+   if (object == nullptr) return;
+   object->~T();
+   size_class<sizeof (T)>().release (object);
+}
+
+#endif
+
@@ -0,0 +1,161 @@
+// $Id: server.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "server.h"
+
+//
+// socket_buf -
+//    A stream buffer reading from and writing to a connected
+//    socket.  Output is held until flushed or the buffer fills.
+//
+
+class socket_buf: public streambuf {
+   private:
+      static const size_t buffer_size = 1 << 16;
+      int fd;
+      char in_buffer[buffer_size];
+      char out_buffer[buffer_size];
+   protected:
+      int_type underflow() override {
+         ssize_t count;
+         do count = recv (fd, in_buffer, buffer_size, 0);
+         while (count < 0 and errno == EINTR);
+         if (count <= 0) return traits_type::eof();
+         setg (in_buffer, in_buffer, in_buffer + count);
+         return traits_type::to_int_type (in_buffer[0]);
+      }
+      int_type overflow (int_type c) override {
+         if (sync() < 0) return traits_type::eof();
+         if (c != traits_type::eof())
+            sputc (traits_type::to_char_type (c));
+         return traits_type::not_eof (c);
+      }
+      // MSG_NOSIGNAL:  a client that has gone away is an error
+      // here, not a SIGPIPE for the whole server.
+      int sync() override {
+         for (char* pos = pbase(); pos < pptr(); )
+         {
+            ssize_t count = send (fd, pos, pptr() - pos, MSG_NOSIGNAL);
+            if (count < 0 and errno == EINTR) continue;
+            if (count <= 0) return -1;
+            pos += count;
+         }
+         setp (out_buffer, out_buffer + buffer_size);
+         return 0;
+      }
+   public:
+      explicit socket_buf (int fd): fd (fd) {
+         setg (in_buffer, in_buffer, in_buffer);
+         setp (out_buffer, out_buffer + buffer_size);
+      }
+};
+
+//
+// tree_guard -
+//    Holds the tree's read or write lock for one command.
+//
+
+class tree_guard {
+   private:
+      tree_guard (const tree_guard&) = delete;
+      tree_guard& operator= (const tree_guard&) = delete;
+      inode_tree& tree;
+   public:
+      tree_guard (inode_tree& tree, bool reading): tree (tree) {
+         if (reading) tree.read_lock();
+                 else tree.write_lock();
+      }
+      ~tree_guard() { tree.unlock(); }
+};
+
+static void session (int fd, commands& cmdmap, inode_tree& tree)
+{
+   DEBUGF ('s', "session " << fd << " opened");
+   socket_buf buffer (fd);
+   iostream client (&buffer);
+   inode_state state (tree);
+   state.set_output (client);
+   try {
+      string line;
+      wordvec words;
+      for (;;) {
+         client << state.get_prompt() << flush;
+         if (not getline (client, line)) break;
+         split (line, " \t", words);
+         if (words.size() == 0 || words.at(0).front() == '#')
+            continue;
+         if (words.at(0) == "exit") break;
+         try {
+            function fn = cmdmap.at (words.at(0));
+            tree_guard guard (tree, cmdmap.reads_only (words.at(0)));
+            if (not state.check_cwd())
+            {
+               client << execname()
+                      << ": working directory was removed;  now at /"
+                      << endl;
+            }
+            run_command (state, cmdmap, words, fn);
+         }catch (yshell_exn& exn) {
+            client << execname() << ": " << exn.what() << endl;
+         }
+      }
+   }catch (exception& exn) {
+      // Anything else ends this session, not the server.
+      DEBUGF ('s', "session " << fd << ": " << exn.what());
+   }
+   client << flush;
+   close (fd);
+   DEBUGF ('s', "session " << fd << " closed");
+}
+
+void serve (const string& socket_path, commands& cmdmap,
+            inode_tree& tree)
+{
+   sockaddr_un address;
+   memset (&address, 0, sizeof address);
+   address.sun_family = AF_UNIX;
+   if (socket_path.size() >= sizeof address.sun_path)
+      throw yshell_exn (socket_path + ": name too long");
+   strcpy (address.sun_path, socket_path.c_str());
+
+   int listener = socket (AF_UNIX, SOCK_STREAM, 0);
+   if (listener < 0)
+      throw yshell_exn (socket_path + ": " + strerror (errno));
+   unlink (socket_path.c_str());
+   if (bind (listener, reinterpret_cast<sockaddr*> (&address),
+             sizeof address) < 0
+       or listen (listener, SOMAXCONN) < 0)
+   {
+      int error = errno;
+      close (listener);
+      throw yshell_exn (socket_path + ": " + strerror (error));
+   }
+
+   tree.set_shared();
+   DEBUGF ('s', "listening on " << socket_path);
+   for (;;)
+   {
+      int fd = accept (listener, nullptr, nullptr);
+      if (fd < 0)
+      {
+         if (errno == EINTR or errno == ECONNABORTED) continue;
+         int error = errno;
+         close (listener);
+         throw yshell_exn (socket_path + ": " + strerror (error));
+      }
+      thread (session, fd, ref (cmdmap), ref (tree)).detach();
+   }
+}
+
@@ -0,0 +1,31 @@
+// $Id: server.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <string>
+
+using namespace std;
+
+#include "commands.h"
+#include "inode.h"
+
+//
+// serve -
+//    Server mode (-s socket).  Listens on a UNIX socket and runs
+//    each client's session on a thread of its own.  A session is a
+//    line-at-a-time shell like the interactive one, with its own
+//    cwd and prompt, but every session works on the same tree.
+//    Commands that only read the tree run at the same time under
+//    the tree's read lock;  the rest take the write lock and run
+//    alone.  exit, or end of file, closes the session.
+//    Returns only by throwing yshell_exn, if the socket can't be
+//    set up.
+//
+
+void serve (const string& socket_path, commands& cmdmap,
+            inode_tree& tree);
+
+#endif
+
@@ -0,0 +1,375 @@
+// $Id: shellbench.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+//
+// shellbench -
+//    Generates yshell scripts for a set of synthetic workloads,
+//    runs each one with "yshell -S stats -f script", and reports
+//    lines per second, peak RSS, and the per-command latencies
+//    yshell recorded.  The scripts come from a fixed seed, so the
+//    same -n gives the same scripts every time.
+//       wide      one directory with n files, read and removed
+//       deep      a chain of directories n/10 deep (at most
+//                 2000), walked with cd, lsr and rmr
+//       balanced  a tree with fanout 8 and n files in its leaves
+//       zipf      n makes and cats of names drawn from a Zipf
+//                 distribution, so a few names are very hot
+//       mixed     n random operations on a growing tree
+//    Not part of yshell;  built and run by "make bench".
+//
+//    usage:  shellbench [-n count] [-y yshell] [-d dir]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+static mt19937 random_engine (109);
+
+static size_t uniform (size_t count)
+{
+   return uniform_int_distribution<size_t> (0, count - 1)
+          (random_engine);
+}
+
+static string numbered (const char* prefix, size_t number)
+{
+   char name[32];
+   snprintf (name, sizeof name, "%s%06zu", prefix, number);
+   return name;
+}
+
+// A few words of file contents.
+static string contents()
+{
+   static const char* words[] = {
+      "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta",
+   };
+   string text;
+   for (size_t count = 1 + uniform (6); count > 0; --count)
+   {
+      text += ' ';
+      text += words[uniform (7)];
+   }
+   return text;
+}
+
+//
+// zipf_names -
+//    Draws ranks in [0, count) with probability proportional to
+//    1 / (rank + 1) ^ exponent.
+//
+class zipf_names {
+   private:
+      vector<double> cumulative;
+   public:
+      zipf_names (size_t count, double exponent) {
+         double total = 0;
+         for (size_t rank = 0; rank < count; ++rank)
+         {
+            total += 1 / pow (rank + 1, exponent);
+            cumulative.push_back (total);
+         }
+         for (double& sum: cumulative) sum /= total;
+      }
+      size_t operator()() {
+         double point = uniform_real_distribution<double> (0, 1)
+                        (random_engine);
+         return lower_bound (cumulative.begin(), cumulative.end(),
+                             point) - cumulative.begin();
+      }
+};
+
+static void wide (ostream& out, size_t count)
+{
+   out << "mkdir /wide\n";
+   for (size_t nr = 0; nr < count; ++nr)
+      out << "make /wide/" << numbered ("f", nr) << contents() << '\n';
+   out << "ls /wide\n";
+   vector<size_t> order (count);
+   for (size_t nr = 0; nr < count; ++nr) order[nr] = nr;
+   shuffle (order.begin(), order.end(), random_engine);
+   for (size_t nr = 0; nr < count / 2; ++nr)
+      out << "cat /wide/" << numbered ("f", order[nr]) << '\n';
+   for (size_t nr = 0; nr < count / 2; ++nr)
+      out << "rm /wide/" << numbered ("f", order[nr]) << '\n';
+   out << "ls /wide\n";
+   out << "rmr /wide\n";
+}
+
+// lsr prints each directory's whole path, so its output grows
+// with the square of the depth;  that is why depth is capped.
+static void deep (ostream& out, size_t count)
+{
+   size_t depth = max<size_t> (1, min<size_t> (count / 10, 2000));
+   out << "mkdir /deep\ncd /deep\n";
+   for (size_t level = 0; level < depth; ++level)
+   {
+      out << "mkdir d\nmake d/f" << contents() << "\ncd d\npwd\n";
+   }
+   out << "cd /\nlsr /deep\n";
+   for (size_t level = 0; level < depth; level += depth / 10 + 1)
+   {
+      out << "cd /deep";
+      for (size_t down = 0; down < level; ++down) out << "/d";
+      out << "\nls\n";
+   }
+   out << "cd /\nrmr /deep\n";
+}
+
+static void balanced (ostream& out, size_t count)
+{
+   const size_t fanout = 8;
+   vector<string> level {"/balanced"};
+   out << "mkdir /balanced\n";
+   while (level.size() * fanout < count)
+   {
+      vector<string> next;
+      for (const auto& dir: level)
+      {
+         for (size_t nr = 0; nr < fanout; ++nr)
+         {
+            next.push_back (dir + "/" + numbered ("d", nr));
+            out << "mkdir " << next.back() << '\n';
+         }
+      }
+      level.swap (next);
+   }
+   vector<string> files;
+   for (size_t nr = 0; nr < count; ++nr)
+   {
+      files.push_back (level[nr % level.size()] + "/"
+                       + numbered ("f", nr / level.size()));
+      out << "make " << files.back() << contents() << '\n';
+   }
+   out << "lsr /balanced\n";
+   for (size_t nr = 0; nr < count / 4; ++nr)
+      out << "cat " << files[uniform (files.size())] << '\n';
+   for (size_t nr = 0; nr < count / 16; ++nr)
+      out << "ls " << level[uniform (level.size())] << '\n';
+   out << "rmr /balanced\n";
+}
+
+static void zipf (ostream& out, size_t count)
+{
+   const size_t dirs = 64;
+   zipf_names draw (max<size_t> (1, count / 4), 1.1);
+   out << "mkdir /zipf\n";
+   for (size_t nr = 0; nr < dirs; ++nr)
+      out << "mkdir /zipf/" << numbered ("s", nr) << '\n';
+   vector<bool> made (count / 4 + 1);
+   auto path = [&] (size_t rank) {
+      return "/zipf/" + numbered ("s", rank % dirs) + "/"
+             + numbered ("w", rank);
+   };
+   for (size_t nr = 0; nr < count; ++nr)
+   {
+      size_t rank = draw();
+      if (made[rank] and nr % 2 == 1)
+      {
+         out << "cat " << path (rank) << '\n';
+      }
+      else
+      {
+         out << "make " << path (rank) << contents() << '\n';
+         made[rank] = true;
+      }
+   }
+   out << "lsr /zipf\n";
+   out << "rmr /zipf\n";
+}
+
+//
+// mixed -
+//    Keeps a model of the tree so every command it writes is one
+//    that succeeds.  Live paths are kept in ordered sets, so rmr
+//    can drop a whole subtree as a range;  the vectors are for
+//    picking at random, and skip paths that are no longer live.
+//
+static void mixed (ostream& out, size_t count)
+{
+   set<string> live_dirs {"/mixed"}, live_files;
+   vector<string> dirs {"/mixed"}, files;
+   auto pick = [] (vector<string>& paths, const set<string>& live)
+               -> string {
+      while (not paths.empty())
+      {
+         size_t index = uniform (paths.size());
+         if (live.count (paths[index]) > 0) return paths[index];
+         swap (paths[index], paths.back());
+         paths.pop_back();
+      }
+      return "";
+   };
+   auto erase_under = [] (set<string>& paths, const string& top) {
+      paths.erase (paths.lower_bound (top + "/"),
+                   paths.lower_bound (top + "0"));
+   };
+   out << "mkdir /mixed\n";
+   size_t serial = 0;
+   for (size_t nr = 0; nr < count; ++nr)
+   {
+      size_t roll = uniform (100);
+      string dir = pick (dirs, live_dirs);
+      string file = pick (files, live_files);
+      if (roll < 35 or file.empty())
+      {
+         string path = dir + "/" + numbered ("f", serial++);
+         out << "make " << path << contents() << '\n';
+         live_files.insert (path);
+         files.push_back (path);
+      }
+      else if (roll < 45)
+      {
+         string path = dir + "/" + numbered ("d", serial++);
+         out << "mkdir " << path << '\n';
+         live_dirs.insert (path);
+         dirs.push_back (path);
+      }
+      else if (roll < 70)
+      {
+         out << "cat " << file << '\n';
+      }
+      else if (roll < 85)
+      {
+         out << "ls " << dir << '\n';
+      }
+      else if (roll < 95)
+      {
+         out << "rm " << file << '\n';
+         live_files.erase (file);
+      }
+      else if (roll < 98 or dir == "/mixed")
+      {
+         out << "lsr " << dir << '\n';
+      }
+      else
+      {
+         out << "rmr " << dir << '\n';
+         live_dirs.erase (dir);
+         erase_under (live_dirs, dir);
+         erase_under (live_files, dir);
+      }
+   }
+   out << "rmr /mixed\n";
+}
+
+// Runs yshell on script with output thrown away, and returns the
+// seconds it took and its peak RSS in kilobytes.
+static void run (const string& yshell, const string& script,
+                 const string& stats, double& seconds, long& rss_kb)
+{
+   auto start = bench_clock::now();
+   pid_t pid = fork();
+   if (pid < 0)
+   {
+      perror ("fork");
+      exit (EXIT_FAILURE);
+   }
+   if (pid == 0)
+   {
+      int null = open ("/dev/null", O_WRONLY);
+      dup2 (null, STDOUT_FILENO);
+      dup2 (null, STDERR_FILENO);
+      execl (yshell.c_str(), yshell.c_str(), "-S", stats.c_str(),
+             "-f", script.c_str(), nullptr);
+      _exit (127);
+   }
+   int status;
+   struct rusage usage;
+   wait4 (pid, &status, 0, &usage);
+   chrono::duration<double> elapsed = bench_clock::now() - start;
+   seconds = elapsed.count();
+   rss_kb = usage.ru_maxrss;
+   if (not WIFEXITED (status) or WEXITSTATUS (status) == 127)
+   {
+      cerr << yshell << ": failed on " << script << endl;
+      exit (EXIT_FAILURE);
+   }
+}
+
+int main (int argc, char** argv) {
+   size_t count = 20000;
+   string yshell = "./yshell";
+   string dir = ".";
+   for (;;)
+   {
+      int option = getopt (argc, argv, "d:n:y:");
+      if (option == EOF) break;
+      switch (option)
+      {
+         case 'd': dir = optarg; break;
+         case 'n': count = strtoul (optarg, nullptr, 10); break;
+         case 'y': yshell = optarg; break;
+         default:
+            cerr << "usage: " << argv[0]
+                 << " [-n count] [-y yshell] [-d dir]" << endl;
+            return EXIT_FAILURE;
+      }
+   }
+   struct workload {
+      const char* name;
+      void (*generate) (ostream&, size_t);
+   };
+   const workload workloads[] = {
+      {"wide", wide}, {"deep", deep}, {"balanced", balanced},
+      {"zipf", zipf}, {"mixed", mixed},
+   };
+   ostringstream tables;
+   cout << "workload      lines    seconds     lines/sec   peak RSS MB"
+        << endl;
+   for (const auto& work: workloads)
+   {
+      string script = dir + "/" + work.name + ".ysh";
+      string stats = dir + "/" + work.name + ".stats";
+      {
+         ofstream out (script);
+         work.generate (out, count);
+         if (not out)
+         {
+            cerr << script << ": can't write" << endl;
+            return EXIT_FAILURE;
+         }
+      }
+      size_t lines = 0;
+      {
+         ifstream in (script);
+         string line;
+         while (getline (in, line)) ++lines;
+      }
+      double seconds;
+      long rss_kb;
+      run (yshell, script, stats, seconds, rss_kb);
+      cout << left << setw (10) << work.name << right
+           << setw (9) << lines << fixed << setprecision (3)
+           << setw (11) << seconds << setprecision (0)
+           << setw (14) << lines / seconds << setprecision (1)
+           << setw (14) << rss_kb / 1024.0 << endl;
+      ifstream table (stats);
+      string line;
+      tables << '\n' << work.name << ":\n";
+      while (getline (table, line)) tables << line << '\n';
+   }
+   cout << tables.str();
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,129 @@
+// $Id: splitbench.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+//
+// splitbench -
+//    Times three ways of splitting yshell command lines into words
+//    and prints lines per second for each:
+//       find_first_of  the old split, a new vector and a new string
+//                      per word, delimiters found by find_first_of
+//       split          util's split into a reused wordvec
+//       tokens         the tokenizer alone, no strings at all
+//    The lines come from a fixed seed and look like the ones
+//    shellbench writes.  Not part of yshell;  built by
+//    "make splitbench".
+//
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "../common/tokenize.h"
+
+typedef chrono::steady_clock bench_clock;
+typedef vector<string> wordvec;
+
+static wordvec old_split (const string& line, const string& delimiter)
+{
+   wordvec words;
+   size_t end = 0;
+   for (;;)
+   {
+      size_t start = line.find_first_not_of (delimiter, end);
+      if (start == string::npos) break;
+      end = line.find_first_of (delimiter, start);
+      words.push_back (line.substr (start, end - start));
+   }
+   return words;
+}
+
+// The same as util.cpp's split into a wordvec, copied here so the
+// benchmark does not link all of yshell.
+static void new_split (const string& line, const delimiter_set& delims,
+                       wordvec& words)
+{
+   tokenizer tokens (line, delims);
+   size_t count = 0;
+   for (token word; tokens.next (word); ++count)
+   {
+      if (count < words.size()) words[count].assign (word.data,
+                                                     word.size);
+      else words.emplace_back (word.data, word.size);
+   }
+   words.resize (count);
+}
+
+static vector<string> make_lines (size_t count)
+{
+   static const char* commands[] = {"make", "cat", "ls", "rm", "cd"};
+   static const char* words[] = {
+      "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta",
+   };
+   mt19937 random (109);
+   vector<string> lines;
+   for (size_t nr = 0; nr < count; ++nr)
+   {
+      char path[64];
+      snprintf (path, sizeof path, "/dir%03zu/sub%02zu/file%06zu",
+                size_t (random() % 1000), size_t (random() % 100), nr);
+      string line = commands[random() % 5];
+      line += random() % 4 == 0 ? "\t" : " ";
+      line += path;
+      if (line[0] == 'm')
+      {
+         for (size_t word = random() % 8; word > 0; --word)
+         {
+            line += random() % 3 == 0 ? "  " : " ";
+            line += words[random() % 7];
+         }
+      }
+      lines.push_back (line);
+   }
+   return lines;
+}
+
+template <typename split_t>
+static void bench (const char* label, const vector<string>& lines,
+                   split_t split)
+{
+   const size_t rounds = 5;
+   size_t words = 0;
+   auto start = bench_clock::now();
+   for (size_t round = 0; round < rounds; ++round)
+   {
+      for (const auto& line: lines) words += split (line);
+   }
+   chrono::duration<double> elapsed = bench_clock::now() - start;
+   cout << left << setw (16) << label << right << fixed
+        << setprecision (0) << setw (14)
+        << rounds * lines.size() / elapsed.count()
+        << "   (" << words << ")" << endl;
+}
+
+int main() {
+   vector<string> lines = make_lines (1000000);
+   const string delimiter = " \t";
+   const delimiter_set delims (delimiter);
+   wordvec reused;
+   cout << "split               lines/sec" << endl;
+   bench ("find_first_of", lines, [&] (const string& line) {
+      return old_split (line, delimiter).size();
+   });
+   bench ("split", lines, [&] (const string& line) {
+      new_split (line, delims, reused);
+      return reused.size();
+   });
+   bench ("tokens", lines, [&] (const string& line) {
+      tokenizer tokens (line, delims);
+      size_t count = 0;
+      for (token word; tokens.next (word); ) count += word.size > 0;
+      return count;
+   });
+   return 0;
+}
@@ -0,0 +1,166 @@
+// $Id: stats.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+using namespace std;
+
+#include "debug.h"
+#include "stats.h"
+#include "util.h"
+
+atomic<bool> command_stats::enabled {false};
+string command_stats::dump_file;
+
+//
+// The global operator new and delete, replaced so allocations can
+// be counted.  They do what the library's do:  call the new
+// handler until malloc succeeds or there is none to call.  The
+// nothrow and array forms all come here.
+//
+
+static thread_local uint64_t thread_allocs {0};
+static thread_local uint64_t thread_bytes {0};
+
+void* operator new (size_t size) {
+   if (command_stats::is_enabled())
+   {
+      ++thread_allocs;
+      thread_bytes += size;
+   }
+   if (size == 0) size = 1;
+   for (;;)
+   {
+      void* where = malloc (size);
+      if (where != nullptr) return where;
+      new_handler handler = get_new_handler();
+      if (handler == nullptr) throw bad_alloc();
+      handler();
+   }
+}
+
+void operator delete (void* where) noexcept {
+   free (where);
+}
+
+void allocation_counts (uint64_t& allocs, uint64_t& bytes) {
+   allocs = thread_allocs;
+   bytes = thread_bytes;
+}
+
+namespace {
+
+   // Buckets 0 to 15 hold 0 to 15ns;  after that, 16 buckets per
+   // power of two.
+   const size_t sub_buckets = 16;
+   const size_t bucket_count = (64 - 3) * sub_buckets;
+
+   size_t bucket_of (uint64_t nanos) {
+      if (nanos < sub_buckets) return nanos;
+      size_t log = 63 - __builtin_clzll (nanos);
+      size_t sub = (nanos >> (log - 4)) & (sub_buckets - 1);
+      return (log - 3) * sub_buckets + sub;
+   }
+
+   // The middle of a bucket's range.
+   uint64_t bucket_value (size_t bucket) {
+      if (bucket < sub_buckets) return bucket;
+      size_t log = bucket / sub_buckets + 3;
+      uint64_t low = (sub_buckets + bucket % sub_buckets) << (log - 4);
+      return low + (uint64_t (1) << (log - 4)) / 2;
+   }
+
+   struct command_record {
+      uint64_t calls {0};
+      uint64_t max_nanos {0};
+      uint64_t allocs {0};
+      uint64_t bytes {0};
+      array<uint64_t, bucket_count> histogram;
+      command_record() { histogram.fill (0); }
+      uint64_t percentile (double fraction) const {
+         uint64_t rank = max<uint64_t> (1, fraction * calls + 0.5);
+         uint64_t seen = 0;
+         for (size_t bucket = 0; bucket < bucket_count; ++bucket)
+         {
+            seen += histogram[bucket];
+            if (seen >= rank)
+               return min (bucket_value (bucket), max_nanos);
+         }
+         return max_nanos;
+      }
+   };
+
+   mutex records_lock;
+   map<string, command_record> records;
+
+}
+
+void command_stats::record (const string& cmd, uint64_t nanos,
+                            uint64_t allocs, uint64_t bytes)
+{
+   lock_guard<mutex> guard (records_lock);
+   command_record& entry = records[cmd];
+   ++entry.calls;
+   entry.max_nanos = max (entry.max_nanos, nanos);
+   entry.allocs += allocs;
+   entry.bytes += bytes;
+   ++entry.histogram[bucket_of (nanos)];
+}
+
+void command_stats::enable (bool on) {
+   enabled.store (on, memory_order_relaxed);
+}
+
+void command_stats::set_dump_file (const string& filename) {
+   dump_file = filename;
+   enable (true);
+}
+
+// Times are in microseconds.
+void command_stats::report (ostream& out) {
+   map<string, command_record> copy;
+   {
+      lock_guard<mutex> guard (records_lock);
+      copy = records;
+   }
+   ostringstream table;
+   table << left << setw (8) << "command" << right
+       << setw (10) << "calls" << setw (11) << "p50 us"
+       << setw (11) << "p99 us" << setw (11) << "max us"
+       << setw (12) << "allocs" << setw (14) << "bytes" << '\n'
+       << fixed << setprecision (1);
+   for (const auto& entry: copy)
+   {
+      const command_record& stats = entry.second;
+      table << left << setw (8) << entry.first << right
+          << setw (10) << stats.calls
+          << setw (11) << stats.percentile (0.50) / 1e3
+          << setw (11) << stats.percentile (0.99) / 1e3
+          << setw (11) << stats.max_nanos / 1e3
+          << setw (12) << stats.allocs
+          << setw (14) << stats.bytes << '\n';
+   }
+   out << table.str() << flush;
+}
+
+void command_stats::clear() {
+   lock_guard<mutex> guard (records_lock);
+   records.clear();
+}
+
+void command_stats::dump() {
+   if (dump_file.empty()) return;
+   ofstream out (dump_file);
+   if (out) report (out);
+   if (not out)
+      complain() << dump_file << ": can't write stats" << endl;
+   DEBUGF ('t', "stats written to " << dump_file);
+}
+
@@ -0,0 +1,101 @@
+// $Id: stats.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+//
+// command_stats -
+//    Per-command call counts, latencies and allocations, kept
+//    while enabled (-S file, or "stats on").  Latencies go into a
+//    histogram per command with 16 buckets for each power of two
+//    nanoseconds, so p50 and p99 are within about 6%;  max is
+//    exact.  Allocations are counted by the global operator new,
+//    per thread, so a server session only counts its own.
+//    When disabled, a timer costs one load and a branch, and so
+//    does each operator new.
+//
+// timer -
+//    Records the time and allocations from its construction to
+//    its destruction against the command cmd, if stats were
+//    enabled when it was made.  A command that throws still
+//    counts.
+// enable -
+//    Turns recording on or off.
+// set_dump_file -
+//    Enables recording and writes the report to filename when
+//    dump is called.
+// report -
+//    Writes a table of every command seen since the last clear.
+// clear -
+//    Forgets everything recorded so far.
+// dump -
+//    Writes the report to the dump file, if there is one.
+//
+
+class command_stats {
+   private:
+      typedef chrono::steady_clock clock;
+      static atomic<bool> enabled;
+      static string dump_file;
+      static void record (const string& cmd, uint64_t nanos,
+                          uint64_t allocs, uint64_t bytes);
+   public:
+      class timer {
+         private:
+            timer (const timer&) = delete;
+            timer& operator= (const timer&) = delete;
+            const string* cmd {nullptr};
+            clock::time_point start;
+            uint64_t allocs;
+            uint64_t bytes;
+         public:
+            explicit timer (const string& cmd);
+            ~timer();
+      };
+      static void enable (bool on);
+      static bool is_enabled();
+      static void set_dump_file (const string& filename);
+      static void report (ostream& out);
+      static void clear();
+      static void dump();
+};
+
+//
+// allocation_counts -
+//    The number of operator new calls, and bytes asked for, made
+//    by this thread while stats were enabled.
+//
+
+void allocation_counts (uint64_t& allocs, uint64_t& bytes);
+
+inline command_stats::timer::timer (const string& cmd_) {
+   if (not command_stats::is_enabled()) return;
+   cmd = &cmd_;
+   allocation_counts (allocs, bytes);
+   start = clock::now();
+}
+
+inline command_stats::timer::~timer() {
+   if (cmd == nullptr) return;
+   chrono::nanoseconds elapsed = clock::now() - start;
+   uint64_t allocs_now, bytes_now;
+   allocation_counts (allocs_now, bytes_now);
+   record (*cmd, elapsed.count(), allocs_now - allocs,
+           bytes_now - bytes);
+}
+
+inline bool command_stats::is_enabled() {
+   return enabled.load (memory_order_relaxed);
+}
+
+#endif
+
@@ -6,6 +6,7 @@
 
 using namespace std;
 
+#include "../common/tokenize.h"
 #include "util.h"
 #include "debug.h"
 
@@ -45,21 +46,93 @@ bool want_echo() {
 
 wordvec split (const string& line, const string& delimiters) {
    wordvec words;
-   size_t end = 0;
-
-   // Loop over the string, splitting out words, and for each word
-   // thus found, append it to the output wordvec.
-   for (;;) {
-      size_t start = line.find_first_not_of (delimiters, end);
-      if (start == string::npos) break;
-      end = line.find_first_of (delimiters, start);
-      words.push_back (line.substr (start, end - start));
+   split (line, delimiters, words);
+   return words;
+}
+
+void split (const string& line, const string& delimiters,
+            wordvec& words) {
+   delimiter_set delimiter_table (delimiters);
+   tokenizer tokens (line, delimiter_table);
+   size_t count = 0;
+   for (token word; tokens.next (word); ++count) {
+      if (count == words.size()) words.emplace_back();
+      words[count].assign (word.data, word.size);
    }
+   words.resize (count);
    DEBUGF ('u', words);
-   return words;
+}
+
+void outbuf::flush() {
+   out.write (buffer.data(), buffer.size());
+   out.flush();
+   buffer.clear();
+}
+
+outbuf& outbuf::operator<< (const string& text) {
+   // Big strings go straight out rather than through the buffer.
+   if (text.size() >= flush_size)
+   {
+      flush();
+      out.write (text.data(), text.size());
+      return *this;
+   }
+   buffer += text;
+   if (buffer.size() >= flush_size) flush();
+   return *this;
+}
+
+outbuf& outbuf::operator<< (char c) {
+   buffer += c;
+   if (buffer.size() >= flush_size) flush();
+   return *this;
+}
+
+batch_output* batch_output::active = nullptr;
+
+batch_output::batch_output(): saved (cout.rdbuf()) {
+   active = this;
+   setp (buffer, buffer + buffer_size);
+   cout.rdbuf (this);
+}
+
+batch_output::~batch_output() {
+   drain();
+   cout.rdbuf (saved);
+   active = nullptr;
+}
+
+void batch_output::drain() {
+   saved->sputn (pbase(), pptr() - pbase());
+   saved->pubsync();
+   setp (buffer, buffer + buffer_size);
+}
+
+void batch_output::drain_active() {
+   if (active != nullptr) active->drain();
+}
+
+batch_output::int_type batch_output::overflow (int_type c) {
+   drain();
+   if (c != traits_type::eof()) sputc (traits_type::to_char_type (c));
+   return traits_type::not_eof (c);
+}
+
+// Big pieces go straight out rather than through the buffer.
+streamsize batch_output::xsputn (const char* text, streamsize count) {
+   if (count >= epptr() - pptr())
+   {
+      drain();
+      if (count >= streamsize (buffer_size))
+         return saved->sputn (text, count);
+   }
+   traits_type::copy (pptr(), text, count);
+   pbump (count);
+   return count;
 }
 
 ostream& complain() {
+   batch_output::drain_active();
    exit_status::set (EXIT_FAILURE);
    cerr << execname() << ": ";
    return cerr;
@@ -79,9 +79,65 @@ class exit_status {
 //    Split a string into a wordvec (as defined above).  Any sequence
 //    of chars in the delimiter string is used as a separator.  To
 //    Split a pathname, use "/".  To split a shell command, use " ".
+//    The second form refills words, reusing the vector and the
+//    strings in it, so splitting line after line into the same
+//    wordvec allocates only when a line has longer words.
 //
 
 wordvec split (const string& line, const string& delimiter);
+void split (const string& line, const string& delimiter,
+            wordvec& words);
+
+//
+// outbuf -
+//    Collects output in one string and writes it to a stream in
+//    large pieces instead of a line at a time.  Whatever is left is
+//    written by the destructor, so output printed before an
+//    exception still comes out ahead of the error message.
+//
+
+class outbuf {
+   private:
+      outbuf (const outbuf&) = delete;
+      outbuf& operator= (const outbuf&) = delete;
+      static const size_t flush_size = 1 << 16;
+      ostream& out;
+      string buffer;
+   public:
+      explicit outbuf (ostream& out): out (out) {}
+      ~outbuf() { flush(); }
+      void flush();
+      outbuf& operator<< (const string& text);
+      outbuf& operator<< (char c);
+};
+
+//
+// batch_output -
+//    While one exists, cout goes into a large buffer instead of
+//    being written out every time endl flushes it.  The buffer is
+//    written when it fills, when complain() is about to write to
+//    cerr (so messages still come out in order), and when the
+//    batch_output goes away.  At most one may exist at a time.
+//
+
+class batch_output: public streambuf {
+   private:
+      batch_output (const batch_output&) = delete;
+      batch_output& operator= (const batch_output&) = delete;
+      static const size_t buffer_size = 1 << 16;
+      static batch_output* active;
+      streambuf* saved;
+      char buffer[buffer_size];
+      void drain();
+   protected:
+      int_type overflow (int_type c) override;
+      streamsize xsputn (const char* text, streamsize count) override;
+      int sync() override { return 0; }
+   public:
+      batch_output();
+      ~batch_output();
+      static void drain_active();
+};
 
 // complain -
 //    Used for starting error messages.  Sets the exit status to
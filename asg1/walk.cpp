@@ -0,0 +1,33 @@
+// $Id: walk.cpp,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+using namespace std;
+
+#include "debug.h"
+#include "walk.h"
+
+vector<inode*> dir_preorder (inode* top)
+{
+   vector<inode*> result;
+   vector<inode*> pending {top};
+   vector<inode*> children;
+   while (not pending.empty())
+   {
+      inode* dir = pending.back();
+      pending.pop_back();
+      result.push_back (dir);
+      // Push in reverse so the first name comes off first.
+      children.clear();
+      for (const auto& dirent: dir->get_dirents())
+      {
+         if (dirent.first == "." || dirent.first == "..") continue;
+         if (dirent.second->get_type() == DIR_INODE)
+            children.push_back (dirent.second);
+      }
+      pending.insert (pending.end(),
+                      children.rbegin(), children.rend());
+   }
+   DEBUGF ('w', result.size() << " directories");
+   return result;
+}
+
@@ -0,0 +1,63 @@
+// $Id: walk.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __WALK_H__
+#define __WALK_H__
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "inode.h"
+
+//
+// Tree traversal without recursion, so the depth of a tree is not
+// limited by the size of the C++ stack.
+//
+// dir_preorder -
+//    Returns top and every directory under it, in the order lsr
+//    lists them:  a directory, then each subdirectory's tree in
+//    name order.  Lazy directories are loaded on the way, so the
+//    tree can be read from several threads afterward.
+// parallel_for -
+//    Calls task (index) for every index in [0, count).  Worker
+//    threads take chunks of indices from a shared counter, so a
+//    thread that finishes early takes over work that would
+//    otherwise wait for a slower one.  Small jobs, and machines
+//    with one core, just run the loop.
+//
+
+vector<inode*> dir_preorder (inode* top);
+
+template <typename task_t>
+void parallel_for (size_t count, task_t task) {
+   const size_t chunk = 64;
+   size_t workers = min<size_t> (thread::hardware_concurrency(),
+                                 count / chunk);
+   if (workers <= 1)
+   {
+      for (size_t index = 0; index < count; ++index) task (index);
+      return;
+   }
+   atomic<size_t> next {0};
+   auto worker = [&]() {
+      for (;;)
+      {
+         size_t first = next.fetch_add (chunk);
+         if (first >= count) break;
+         size_t last = min (first + chunk, count);
+         for (size_t index = first; index < last; ++index) task (index);
+      }
+   };
+   vector<thread> threads;
+   for (size_t nr = 1; nr < workers; ++nr)
+      threads.emplace_back (worker);
+   worker();
+   for (auto& thread: threads) thread.join();
+}
+
+#endif
+
@@ -0,0 +1,201 @@
+// $Id: bigdec.cpp,v 1.1 2014-04-11 11:58:33-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#include <algorithm>
+#include <limits>
+using namespace std;
+
+#include "bigdec.h"
+#include "debug.h"
+#include "util.h"
+
+// Passed as k to get an exact, untruncated product.
+static const size_t EXACT = numeric_limits<size_t>::max();
+
+bigdec::bigdec()
+: mantissa {}, scale_ {0}
+{
+}
+
+bigdec::bigdec (const bigint& mantissa, size_t scale)
+: mantissa (mantissa), scale_ (scale)
+{
+}
+
+bigdec::bigdec (const string& that)
+: mantissa {}, scale_ {0}
+{
+   // Strip the '.' out of the literal and count the digits after it.
+   // The remaining digits (and '_') are exactly what bigint wants.
+   string digits;
+   bool seen_point = false;
+   for (char c : that)
+   {
+      if (c == '.')
+      {
+         seen_point = true;
+         continue;
+      }
+      if (c != '_' and seen_point) ++scale_;
+      digits += c;
+   }
+   if (digits.find_first_not_of ('_') != string::npos)
+   {
+      mantissa = bigint (digits);
+   }
+   DEBUGF ('d', that << " -> " << mantissa << " scale " << scale_);
+}
+
+bigint bigdec::magnitude() const
+{
+   bigint result = mantissa;
+   result.negative = false;
+   return result;
+}
+
+bigdec bigdec::rescale (size_t scale) const
+{
+   bigdec result = *this;
+   if (scale > scale_)
+   {
+      result.mantissa.mul_pow10 (scale - scale_);
+   }
+   else
+   {
+      result.mantissa.div_pow10 (scale_ - scale);
+   }
+   result.scale_ = scale;
+   return result;
+}
+
+long bigdec::to_long() const
+{
+   return rescale (0).mantissa.to_long();
+}
+
+bigdec bigdec::operator+ (const bigdec& that) const
+{
+   size_t scale = max (scale_, that.scale_);
+   return bigdec (rescale (scale).mantissa
+                  + that.rescale (scale).mantissa, scale);
+}
+
+bigdec bigdec::operator- (const bigdec& that) const
+{
+   size_t scale = max (scale_, that.scale_);
+   return bigdec (rescale (scale).mantissa
+                  - that.rescale (scale).mantissa, scale);
+}
+
+bigdec bigdec::operator-() const
+{
+   return bigdec (-mantissa, scale_);
+}
+
+bigdec bigdec::mul (const bigdec& that, size_t k) const
+{
+   size_t exact = scale_ + that.scale_;
+   bigdec result (mantissa * that.mantissa, exact);
+   if (k == EXACT) return result;
+   return result.rescale (min (exact, max (k, max (scale_,
+                                                   that.scale_))));
+}
+
+//
+// Division -
+//    left / right = (L / 10^sl) / (R / 10^sr), so the quotient
+//    at scale k is L * 10^(sr + k - sl) / R.  Only the side with
+//    a positive exponent is shifted.  bigint::divide only gets
+//    the sign right for a positive divisor, so divide magnitudes
+//    and fix the sign afterwards.
+//
+bigdec bigdec::div (const bigdec& that, size_t k) const
+{
+   if (that.is_zero()) throw ydc_exn ("divide by zero");
+   bigint left = magnitude();
+   bigint right = that.magnitude();
+   if (that.scale_ + k >= scale_)
+   {
+      left.mul_pow10 (that.scale_ + k - scale_);
+   }
+   else
+   {
+      right.mul_pow10 (scale_ - that.scale_ - k);
+   }
+   bigint quotient = left / right;
+   if (is_negative() != that.is_negative()) quotient = -quotient;
+   return bigdec (quotient, k);
+}
+
+bigdec bigdec::rem (const bigdec& that, size_t k) const
+{
+   bigdec quotient = div (that, k);
+   return *this - quotient.mul (that, EXACT);
+}
+
+ostream& operator<< (ostream& out, const bigdec& that)
+{
+   string text;
+   if (that.is_zero())
+   {
+      text = "0";
+   }
+   else
+   {
+      const bigvalue_t& digits = that.digits();
+      if (that.is_negative()) text += '-';
+      for (size_t pos = digits.size(); pos > that.scale_; --pos)
+      {
+         text += static_cast<char> (digits[pos - 1] + '0');
+      }
+      if (that.scale_ > 0)
+      {
+         text += '.';
+         for (size_t pos = that.scale_; pos > 0; --pos)
+         {
+            digit_t dig = pos <= digits.size() ? digits[pos - 1] : 0;
+            text += static_cast<char> (dig + '0');
+         }
+      }
+   }
+   // Number of characters dc displays per line
+   const size_t perline = 69;
+   size_t pos = 0;
+   for (; text.size() - pos > perline; pos += perline)
+   {
+      out << text.substr (pos, perline) << "\\" << endl;
+   }
+   out << text.substr (pos);
+   return out;
+}
+
+bigdec pow (const bigdec& base, const bigdec& exponent, size_t k)
+{
+   DEBUGF ('^', "base = " << base << ", exponent = " << exponent);
+   long expt = exponent.to_long();
+   bool invert = expt < 0;
+   if (invert) expt = - expt;
+   bigdec base_copy = base;
+   bigdec result = bigint (1);
+   while (expt > 0) {
+      if (expt & 1) { //odd
+         result = result.mul (base_copy, EXACT);
+         --expt;
+      }else { //even
+         base_copy = base_copy.mul (base_copy, EXACT);
+         expt /= 2;
+      }
+   }
+   if (invert)
+   {
+      result = bigdec (bigint (1)).div (result, k);
+   }
+   else
+   {
+      result = result.rescale (min (result.scale(),
+                                    max (k, base.scale())));
+   }
+   DEBUGF ('^', "result = " << result);
+   return result;
+}
+
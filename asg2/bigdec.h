@@ -0,0 +1,65 @@
+// $Id: bigdec.h,v 1.1 2014-04-11 11:58:33-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __BIGDEC_H__
+#define __BIGDEC_H__
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include "bigint.h"
+
+//
+// bigdec -
+//    A scaled decimal number:  the value is mantissa / 10^scale.
+//    The number of fractional digits carried by each operation
+//    follows dc(1), so the operations that may lose digits take
+//    the current value of the k register as an argument.
+//
+// add/sub -
+//    Exact.  The result has the larger of the two scales.
+// mul -
+//    Scale is min (sa + sb, max (k, sa, sb)).
+// div -
+//    Scale is k.
+// rem -
+//    left - (left / right) * right with the quotient at scale k,
+//    so the scale is max (sb + k, sa).
+// pow -
+//    The exponent is used as an integer.  For a non-negative
+//    exponent e the scale is min (sa * e, max (k, sa)); for a
+//    negative exponent it is k.
+//
+// Rescaling never multiplies by a power of ten:  bigint stores
+// decimal digits, so it is a digit shift (see bigint::mul_pow10).
+//
+
+class bigdec {
+      friend ostream& operator<< (ostream&, const bigdec&);
+   private:
+      bigint mantissa;
+      size_t scale_;
+      bool is_negative() const { return mantissa.negative; }
+      const bigvalue_t& digits() const { return mantissa.big_value; }
+      bool is_zero() const { return digits().size() == 0; }
+      bigint magnitude() const;
+   public:
+      bigdec();
+      bigdec (const bigint& mantissa, size_t scale = 0);
+      bigdec (const string&);
+      size_t scale() const { return scale_; }
+      bigdec rescale (size_t) const;
+      long to_long() const;
+      bigdec operator+ (const bigdec&) const;
+      bigdec operator- (const bigdec&) const;
+      bigdec operator-() const;
+      bigdec mul (const bigdec&, size_t k) const;
+      bigdec div (const bigdec&, size_t k) const;
+      bigdec rem (const bigdec&, size_t k) const;
+};
+
+bigdec pow (const bigdec& base, const bigdec& exponent, size_t k);
+
+#endif
+
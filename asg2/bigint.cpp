@@ -283,6 +283,26 @@ bigint bigint::operator% (const bigint& that) const
    return divide (that).second;
 }
 
+void bigint::mul_pow10 (size_t count)
+{
+   if (big_value.size() == 0) return;
+   big_value.insert (big_value.begin(), count, 0);
+}
+
+void bigint::div_pow10 (size_t count)
+{
+   if (count >= big_value.size())
+   {
+      big_value.clear();
+   }
+   else
+   {
+      big_value.erase (big_value.begin(), big_value.begin() + count);
+   }
+   trim();
+   if (big_value.size() == 0) negative = false;
+}
+
 bool bigint::operator== (const bigint& that) const 
 {
    if (that.negative != negative) return false;
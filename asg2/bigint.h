@@ -18,6 +18,7 @@ typedef unsigned char digit_t;
 typedef vector<digit_t> bigvalue_t;
 class bigint {
       friend ostream& operator<< (ostream&, const bigint&);
+      friend class bigdec;
    private:
       bool negative;
       bigvalue_t big_value;
@@ -56,6 +57,13 @@ class bigint {
       bigint operator/ (const bigint&) const;
       bigint operator% (const bigint&) const;
       //
+      // Scaling by powers of ten.  Since big_value holds decimal
+      // digits these are digit shifts, not multiplications.
+      // div_pow10 truncates toward zero.
+      //
+      void mul_pow10 (size_t);
+      void div_pow10 (size_t);
+      //
       // Comparison operators.
       //
       bool operator== (const bigint&) const;
@@ -10,35 +10,41 @@ using namespace std;
 
 #include <unistd.h>
 
-#include "bigint.h"
+#include "bigdec.h"
 #include "debug.h"
 #include "iterstack.h"
 #include "scanner.h"
 #include "util.h"
 
-typedef iterstack<bigint> bigint_stack;
+typedef iterstack<bigdec> bigdec_stack;
 
-void do_arith (bigint_stack& stack, const char oper) {
+//
+// The k register:  the number of fractional digits kept by the
+// operations that can lose precision.  See bigdec.h.
+//
+static size_t scale_k {0};
+
+void do_arith (bigdec_stack& stack, const char oper) {
    // Added to avoid segfaults
    if (stack.size() < 2)
    {
       complain() << "stack empty" << endl;
       return;
    }
-   bigint right = stack.top(); \
+   bigdec right = stack.top(); \
    stack.pop(); \
    DEBUGF ('d', "right = " << right); \
-   bigint left = stack.top(); \
+   bigdec left = stack.top(); \
    stack.pop(); \
    DEBUGF ('d', "left = " << left); \
-   bigint result;
+   bigdec result;
    switch (oper) {
       case '+': result = left + right; break;
       case '-': result = left - right; break;
-      case '*': result = left * right; break;
-      case '/': result = left / right; break;
-      case '%': result = left % right; break;
-      case '^': result = pow (left, right); break;
+      case '*': result = left.mul (right, scale_k); break;
+      case '/': result = left.div (right, scale_k); break;
+      case '%': result = left.rem (right, scale_k); break;
+      case '^': result = pow (left, right, scale_k); break;
       default: throw invalid_argument (
                      string ("do_arith operator is ") + oper);
    }
@@ -46,37 +52,54 @@ void do_arith (bigint_stack& stack, const char oper) {
    stack.push (result); \
 }
 
-void do_clear (bigint_stack& stack, const char) {
+void do_clear (bigdec_stack& stack, const char) {
    DEBUGF ('d', "");
    stack.clear();
 }
 
-void do_dup (bigint_stack& stack, const char) {
-   bigint top = stack.top();
+void do_dup (bigdec_stack& stack, const char) {
+   bigdec top = stack.top();
    DEBUGF ('d', top);
    stack.push (top);
 }
 
+void do_setscale (bigdec_stack& stack, const char) {
+   if (stack.empty())
+   {
+      complain() << "stack empty" << endl;
+      return;
+   }
+   long scale = stack.top().to_long();
+   if (scale < 0) throw ydc_exn ("scale must be a nonnegative number");
+   stack.pop();
+   scale_k = scale;
+   DEBUGF ('d', "k = " << scale_k);
+}
+
+void do_getscale (bigdec_stack& stack, const char) {
+   stack.push (bigint (scale_k));
+}
+
 
-void do_printall (bigint_stack& stack, const char) {
+void do_printall (bigdec_stack& stack, const char) {
    for (const auto &elem: stack) cout << elem << endl;
 }
 
-void do_print (bigint_stack& stack, const char) {
+void do_print (bigdec_stack& stack, const char) {
    cout << stack.top() << endl;
 }
 
-void do_debug (bigint_stack& stack, const char) {
+void do_debug (bigdec_stack& stack, const char) {
    (void) stack; // SUPPRESS: warning: unused parameter 'stack'
    cout << "Y not implemented" << endl;
 }
 
 class ydc_quit: public exception {};
-void do_quit (bigint_stack&, const char) {
+void do_quit (bigdec_stack&, const char) {
    throw ydc_quit();
 }
 
-typedef void (*function_t) (bigint_stack&, const char);
+typedef void (*function_t) (bigdec_stack&, const char);
 typedef map <string, function_t> fn_map;
 fn_map do_functions = {
    {"+", do_arith},
@@ -88,6 +111,8 @@ fn_map do_functions = {
    {"Y", do_debug},
    {"c", do_clear},
    {"d", do_dup},
+   {"k", do_setscale},
+   {"K", do_getscale},
    {"f", do_printall},
    {"p", do_print},
    {"q", do_quit},
@@ -123,7 +148,7 @@ void scan_options (int argc, char** argv) {
 int main (int argc, char** argv) {
    sys_info::execname (argv[0]);
    scan_options (argc, argv);
-   bigint_stack operand_stack;
+   bigdec_stack operand_stack;
    scanner input;
    try {
       for (;;) {
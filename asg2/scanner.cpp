@@ -24,12 +24,17 @@ token_t scanner::scan() {
    while (not seen_eof and isspace (lookahead)) advance();
    if (seen_eof) {
       result.symbol = SCANEOF;
-   }else if (lookahead == '_' or isdigit (lookahead)) {
+   }else if (lookahead == '_' or lookahead == '.'
+             or isdigit (lookahead)) {
+      // A second '.' starts a new number, as in dc.
       result.symbol = NUMBER;
+      bool seen_point = false;
       do {
+         if (lookahead == '.') seen_point = true;
          result.lexinfo += lookahead;
          advance();
-      }while (not seen_eof and isdigit (lookahead));
+      }while (not seen_eof and (isdigit (lookahead)
+              or (lookahead == '.' and not seen_point)));
    }else {
       result.symbol = OPERATOR;
       result.lexinfo += lookahead;
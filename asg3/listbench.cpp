@@ -0,0 +1,190 @@
+// Author: Coy Humphrey (cmhumphr)
+
+//
+// listbench -
+//    Loads 1M keys into a listmap in random order, then destroys
+//    it, once with nodes from a node_pool and once from the heap,
+//    for string pairs and for int pairs, which need no destructor.
+//    Prints nanoseconds per key for each.
+//
+//    Then, for 10k to 1M string keys, with and without a hash
+//    index, times finding every key in random order 4 times over,
+//    and then finding and erasing each.  Prints nanoseconds per
+//    find and per erase.
+//
+//    Last, for the same sizes, with and without a value index,
+//    loads keys with one of size / 4 values each, and times 100
+//    lookups of random values.  Prints nanoseconds per key loaded
+//    and microseconds per lookup.
+//
+//    Not part of keyvalue;  built by "make listbench".
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "listmap.h"
+
+typedef chrono::steady_clock bench_clock;
+
+static double ns_per (bench_clock::time_point start, size_t ops)
+{
+   chrono::duration<double, nano> elapsed = bench_clock::now() - start;
+   return elapsed.count() / ops;
+}
+
+template <typename map_t, typename key_t>
+static void bench (const char* label, const vector<key_t>& keys)
+{
+   bench_clock::time_point start = bench_clock::now();
+   map_t* map = new map_t();
+   for (const auto& key: keys)
+   {
+      map->insert (typename map_t::value_type (key, key));
+   }
+   double load_ns = ns_per (start, keys.size());
+   start = bench_clock::now();
+   delete map;
+   double destroy_ns = ns_per (start, keys.size());
+   cout << left << setw (20) << label << right << fixed
+        << setprecision (1) << setw (10) << load_ns
+        << setw (10) << destroy_ns << endl;
+}
+
+template <typename map_t>
+static void bench_lookup (const char* label,
+                          const vector<string>& keys,
+                          const vector<string>& probes)
+{
+   map_t map;
+   for (const auto& key: keys)
+   {
+      map.insert (typename map_t::value_type (key, key));
+   }
+   size_t found = 0;
+   bench_clock::time_point start = bench_clock::now();
+   for (int round = 0; round < 4; ++round)
+   {
+      for (const auto& probe: probes)
+      {
+         if (map.find (probe) != map.end()) ++found;
+      }
+   }
+   double find_ns = ns_per (start, 4 * probes.size());
+   start = bench_clock::now();
+   for (const auto& probe: probes) map.find (probe).erase();
+   double erase_ns = ns_per (start, probes.size());
+   if (found != 4 * keys.size() or not map.empty())
+   {
+      cerr << label << ": wrong answer" << endl;
+   }
+   cout << left << setw (20) << label << right << fixed
+        << setprecision (1) << setw (10) << find_ns
+        << setw (10) << erase_ns << endl;
+}
+
+template <typename map_t>
+static void bench_values (const char* label,
+                          const vector<string>& keys,
+                          const vector<string>& loaded,
+                          const vector<string>& values)
+{
+   map_t map;
+   bench_clock::time_point start = bench_clock::now();
+   for (size_t nr = 0; nr < keys.size(); ++nr)
+   {
+      map.insert (typename map_t::value_type (keys[nr], loaded[nr]));
+   }
+   double load_ns = ns_per (start, keys.size());
+   size_t found = 0;
+   start = bench_clock::now();
+   for (const auto& value: values)
+   {
+      found += map.find_value (value).size();
+   }
+   double lookup_us = ns_per (start, values.size()) / 1000;
+   cout << left << setw (20) << label << right << fixed
+        << setprecision (1) << setw (10) << load_ns
+        << setw (10) << lookup_us << setw (10)
+        << found / values.size() << endl;
+}
+
+static vector<string> key_names (const vector<int>& numbers)
+{
+   vector<string> names;
+   for (int number: numbers)
+   {
+      char name[32];
+      snprintf (name, sizeof name, "key%07d", number);
+      names.push_back (name);
+   }
+   return names;
+}
+
+int main() {
+   const size_t count = 1000000;
+   mt19937 random (109);
+   vector<int> numbers (count);
+   for (size_t nr = 0; nr < count; ++nr) numbers[nr] = nr;
+   shuffle (numbers.begin(), numbers.end(), random);
+   vector<string> names = key_names (numbers);
+   cout << "map                      load   destroy   (ns/key)" << endl;
+   bench<listmap<string,string,xless<string>,node_pool>>
+         ("string node_pool", names);
+   bench<listmap<string,string,xless<string>,node_heap>>
+         ("string node_heap", names);
+   bench<listmap<int,int,xless<int>,node_pool>>
+         ("int node_pool", numbers);
+   bench<listmap<int,int,xless<int>,node_heap>>
+         ("int node_heap", numbers);
+   typedef listmap<string,string> plain_map;
+   typedef listmap<string,string,xless<string>,node_pool,
+                   xhash<string>> hashed_map;
+   for (size_t size: {10000, 100000, 1000000})
+   {
+      vector<int> some (numbers.begin(), numbers.begin() + size);
+      vector<string> keys = key_names (some);
+      shuffle (some.begin(), some.end(), random);
+      vector<string> probes = key_names (some);
+      cout << endl << left << setw (20) << to_string (size) + " keys"
+           << right << setw (10) << "find" << setw (10) << "erase"
+           << "   (ns/op)" << endl;
+      bench_lookup<plain_map> ("no_hash", keys, probes);
+      bench_lookup<hashed_map> ("xhash", keys, probes);
+   }
+   mt19937 pick (110);
+   for (size_t size: {10000, 100000, 1000000})
+   {
+      vector<string> keys (names.begin(), names.begin() + size);
+      vector<string> loaded, values;
+      for (size_t nr = 0; nr < size; ++nr)
+      {
+         loaded.push_back ("value" + to_string (nr % (size / 4)));
+      }
+      for (int nr = 0; nr < 100; ++nr)
+      {
+         values.push_back ("value" + to_string (pick() % (size / 4)));
+      }
+      cout << endl << left << setw (20) << to_string (size) + " keys"
+           << right << setw (10) << "load ns" << setw (10)
+           << "lookup us" << setw (10) << "matches" << endl;
+      typedef listmap<string,string,xless<string>,node_pool,
+                      xhash<string>> plain_map;
+      typedef listmap<string,string,xless<string>,node_pool,
+                      xhash<string>,xhash<string>> value_map;
+      bench_values<plain_map> ("no value index", keys, loaded,
+                               values);
+      bench_values<value_map> ("xhash values", keys, loaded,
+                               values);
+   }
+   return 0;
+}
+
@@ -3,25 +3,140 @@
 #ifndef __LISTMAP_H__
 #define __LISTMAP_H__
 
+#include <cstddef>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "nodepool.h"
+#include "xhash.h"
 #include "xless.h"
 #include "xpair.h"
 
-template <typename Key, typename Value, class Less=xless<Key>>
+//
+// listmap -
+//    An ordered map kept as a skip list.  Level 0 is the doubly
+//    linked list from head to tail that the iterators walk, in key
+//    order.  A node also sits on levels 1 up to its height - 1,
+//    each of which skips over about 3 of every 4 nodes on the
+//    level below, so insert, find and erase look at O(log n) nodes
+//    instead of walking the whole list.  Heights come from a fixed
+//    seed, so a run is the same every time.
+//
+//    Alloc is where nodes come from (see nodepool.h);  a node and
+//    its levels are one block.  With node_pool, and a value_type
+//    that needs no destructor, the whole map is freed a slab at a
+//    time rather than a node at a time.
+//
+//    Hash is whether there is a hash index of the keys as well (see
+//    xhash.h), chained through the nodes.  With one, find and
+//    replacing the value of a key already there take O(1) time, and
+//    so does erasing any node that is only on level 0, as 3 in 4
+//    are.
+//
+//    ValueHash is whether there is an index of the values too:  for
+//    each value's hash, the set of nodes with a value that has it,
+//    in key order.  It is kept up to date by insert, erase and
+//    set_value, so find_value takes time in proportion to the pairs
+//    it finds rather than to the size of the map.  With it, a pair
+//    is read-only through an iterator, so no value can change
+//    behind the index's back.
+//
+// insert -
+//    Adds the pair, or replaces the value of an equal key.  An
+//    rvalue pair is moved into the map.
+// emplace -
+//    insert of the pair made from args, which it is made in place
+//    from, so strings passed as rvalues are never copied.
+// find -
+//    The pair with an equal key, or end().  With a transparent Less
+//    (and Hash), such as xless, anything Less can compare with a
+//    key will do, such as a token, without making a key from it.
+// find_value -
+//    The pairs with an equal value, in key order.  Anything that
+//    compares with a value both ways round with operator<, and that
+//    ValueHash hashes, will do, such as a token.
+// iterator::erase -
+//    Removes the pair and moves to the one after it.
+// iterator::set_value -
+//    Replaces the value of the pair, moving it to the value's group
+//    in the value index, if there is one.
+//
+
+template <typename Key, typename Value, class Less=xless<Key>,
+          class Alloc=node_pool, class Hash=no_hash<Key>,
+          class ValueHash=no_hash<Value>>
 class listmap {
    public:
       typedef Key key_type;
       typedef Value mapped_type;
       typedef xpair<key_type,mapped_type> value_type;
+      // What an iterator gives access to
+      typedef typename conditional<ValueHash::indexes,
+                                   const value_type,
+                                   value_type>::type iterated_type;
    private:
+      static const int max_height = 32;
       Less less;
+      Alloc alloc;
+      Hash hasher;
+      ValueHash value_hasher;
       struct node {
          value_type pair;
          node* prev;
          node* next;
-         node (const value_type&);
+         // Next node in the same hash bucket, and the key's hash
+         node* chain;
+         size_t hash;
+         // Next node on levels 1 to height - 1, which follow the
+         // node in the same block
+         int height;
+         node** skips;
+         template <typename Pair>
+         node (Pair&& pair, int height);
       };
+      struct key_order {
+         Less less;
+         bool operator() (const node* left, const node* right) const {
+            return less (left->pair.first, right->pair.first);
+         }
+      };
+      typedef set<node*, key_order> value_group;
       node* head;
       node* tail;
+      node* skip_heads[max_height - 1];
+      int height;
+      unsigned random_state;
+      // Hash buckets, a power of 2 of them, and the nodes in them
+      vector<node*> buckets;
+      size_t indexed;
+      unordered_map<size_t, value_group> values;
+      node*& forward (node* from, int level);
+      template <typename Lookup>
+      node* find_path (const Lookup&, node** path);
+      template <typename Lookup>
+      node* find_node (const Lookup&);
+      int random_height();
+      static size_t node_bytes (int height);
+      template <typename Pair>
+      node* new_node (Pair&& pair, int height);
+      template <typename Pair>
+      void insert_pair (Pair&& pair);
+      void delete_node (node* where);
+      void unlink (node* where);
+      template <typename Lookup>
+      bool equal (const key_type&, const Lookup&) const;
+      template <typename Lookup>
+      node* index_find (const Lookup&, size_t hash) const;
+      void index_add (node* added);
+      void index_remove (node* where);
+      void value_add (node* added);
+      void value_remove (node* where);
+      template <typename Mapped>
+      void replace_value (node* found, Mapped&& value);
+      template <typename Lookup>
+      static bool same_value (const mapped_type&, const Lookup&);
    public:
       class iterator;
       listmap();
@@ -29,27 +144,39 @@ class listmap {
       listmap& operator= (const listmap&);
       ~listmap();
       void insert (const value_type&);
+      void insert (value_type&&);
+      template <typename... Args>
+      void emplace (Args&&... args);
       iterator find (const key_type&);// const;
+      template <typename Lookup, typename L = Less,
+                typename = typename L::is_transparent>
+      iterator find (const Lookup&);
+      vector<iterator> find_value (const mapped_type&);
+      template <typename Lookup>
+      vector<iterator> find_value (const Lookup&);
       iterator begin();
       iterator end();
       bool empty() const;
 };
 
-
-template <typename Key, typename Value, class Less=xless<Key>>
-class listmap<Key,Value,Less>::iterator {
-      friend class listmap<Key,Value>;
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+class listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator {
+      friend class listmap<Key,Value,Less,Alloc,Hash,ValueHash>;
    private:
       iterator (listmap* map, node* where);
-      listmap<Key,Value,Less>* map;
+      listmap<Key,Value,Less,Alloc,Hash,ValueHash>* map;
       node* where;
    public:
       iterator(): map(NULL), where(NULL) {}
-      value_type& operator*();
-      value_type* operator->();
+      iterated_type& operator*();
+      iterated_type* operator->();
       iterator& operator++(); //++itor
       iterator& operator--(); //--itor
       void erase();
+      template <typename Mapped>
+      void set_value (Mapped&& value);
       bool operator== (const iterator&) const;
       inline bool operator!= (const iterator& that) const {
          return not (*this == that);
@@ -1,140 +1,494 @@
 // Author: Coy Humphrey (cmhumphr)
 
+#include <new>
+#include <type_traits>
+#include <utility>
+
 #include "listmap.h"
 #include "trace.h"
 
-template <typename Key, typename Value, class Less>
-listmap<Key,Value,Less>::node::node (const value_type& pair):
-            pair(pair), prev(nullptr), next(nullptr) 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Pair>
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node::node (Pair&& pair,
+            int height): pair(std::forward<Pair> (pair)),
+            prev(nullptr), next(nullptr), chain (nullptr), hash (0),
+            height (height), skips (nullptr)
 {
+   if (height > 1) skips = reinterpret_cast<node**> (this + 1);
 }
 
-template <typename Key, typename Value, class Less>
-listmap<Key,Value,Less>::listmap (): head(nullptr), tail (nullptr) 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::listmap (): head(nullptr),
+            tail (nullptr), height (1), random_state (2463534242u),
+            indexed (0)
 {
-   
+   for (node*& skip_head: skip_heads) skip_head = nullptr;
 }
 
-template <typename Key, typename Value, class Less>
-listmap<Key,Value,Less>::~listmap () {
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::~listmap () {
    TRACE ('l', (void*) this);
-   while (!empty())
+   // Otherwise the pool's own destructor frees everything.
+   if (Alloc::frees_all
+       && is_trivially_destructible<value_type>::value) return;
+   while (head != nullptr)
    {
-      auto itor = begin();
-      itor.erase();
+      node *next = head->next;
+      if (Alloc::frees_all) head->~node();
+      else delete_node (head);
+      head = next;
    }
 }
 
-template <typename Key, typename Value, class Less>
-void listmap<Key,Value,Less>::insert (const xpair<Key,Value>& pair) {
-   TRACE ('l', &pair << "->" << pair);
-   node *itor = head;
-   while (itor != nullptr)
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+size_t
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node_bytes (int height)
+{
+   return sizeof (node) + (height - 1) * sizeof (node*);
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Pair>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node*
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::new_node (Pair&& pair,
+            int height)
+{
+   void *where = alloc.allocate (node_bytes (height));
+   try {
+      return new (where) node (std::forward<Pair> (pair), height);
+   }catch (...) {
+      alloc.deallocate (where, node_bytes (height));
+      throw;
+   }
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::delete_node (node* where)
+{
+   int height = where->height;
+   where->~node();
+   alloc.deallocate (where, node_bytes (height));
+}
+
+// The link from a node, or from the front of the map when from is
+// nullptr, to the next node on level.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node*&
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::forward (
+            node* from, int level)
+{
+   if (level == 0) return from == nullptr ? head : from->next;
+   return from == nullptr ? skip_heads[level - 1]
+                          : from->skips[level - 1];
+}
+
+//
+// find_path -
+//    Goes down from the top level, moving right while the next
+//    key is less than key.  Leaves in path[level] the last node
+//    on each level before key (nullptr for the front), and
+//    returns the first node not less than key, or nullptr.
+//
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node*
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::find_path (
+            const Lookup& key, node** path)
+{
+   node *before = nullptr;
+   for (int level = height - 1; level >= 0; --level)
    {
-      // While the new item is greater than the current item
-      if (less (itor->pair.first, pair.first))
+      for (;;)
       {
-         itor = itor->next;
-         continue;
+         node *next = forward (before, level);
+         if (next == nullptr || !less (next->pair.first, key)) break;
+         before = next;
       }
-      else if (!less (pair.first, itor->pair.first))
+      path[level] = before;
+   }
+   return forward (before, 0);
+}
+
+// Height h with probability (3/4) (1/4)^(h-1), from an xorshift
+// generator:  two random bits per level.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+int listmap<Key,Value,Less,Alloc,Hash,ValueHash>::random_height ()
+{
+   random_state ^= random_state << 13;
+   random_state ^= random_state >> 17;
+   random_state ^= random_state << 5;
+   unsigned bits = random_state;
+   int result = 1;
+   while ((bits & 3) == 0 && result < max_height)
+   {
+      ++result;
+      bits >>= 2;
+      if (bits == 0) break;
+   }
+   return result;
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::insert
+            (const value_type& pair) {
+   insert_pair (pair);
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::insert
+            (value_type&& pair) {
+   insert_pair (std::move (pair));
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename... Args>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::emplace
+            (Args&&... args) {
+   insert_pair (value_type (std::forward<Args> (args)...));
+}
+
+// The pair is moved from if it is an rvalue, and then only once,
+// into either the node found or the node made.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Pair>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::insert_pair
+            (Pair&& pair) {
+   TRACE ('l', &pair << "->" << pair);
+   size_t hash = 0;
+   if (Hash::indexes)
+   {
+      hash = hasher (pair.first);
+      node *found = index_find (pair.first, hash);
+      if (found != nullptr)
       {
-         // Keys are equal
-         itor->pair.second = pair.second;
+         replace_value (found, std::forward<Pair> (pair).second);
          return;
       }
-      // Not equal and in correct order
-      else
+   }
+   node *path[max_height];
+   node *found = find_path (pair.first, path);
+   if (!Hash::indexes && found != nullptr
+       && !less (pair.first, found->pair.first))
+   {
+      // Keys are equal
+      replace_value (found, std::forward<Pair> (pair).second);
+      return;
+   }
+   int new_height = random_height();
+   node *added = new_node (std::forward<Pair> (pair), new_height);
+   try {
+      if (ValueHash::indexes) value_add (added);
+      if (Hash::indexes)
       {
-         node *new_node = new node (pair);
-         new_node->next = itor;
-         new_node->prev = itor->prev;
-         if (new_node->prev != nullptr)
-         {
-            new_node->prev->next = new_node;
-         }
-         else
-         {
-            head = new_node;
-         }
-         if (new_node->next != nullptr)
-         {
-            new_node->next->prev = new_node;
-         }
-         else
-         {
-            tail = new_node;
-         }
-         return;
+         added->hash = hash;
+         index_add (added);
       }
+   }catch (...) {
+      if (ValueHash::indexes) value_remove (added);
+      delete_node (added);
+      throw;
    }
-   if (empty())
+   for (; height < new_height; ++height) path[height] = nullptr;
+   for (int level = 0; level < new_height; ++level)
    {
-      head = tail = new node (pair);
+      node*& link = forward (path[level], level);
+      forward (added, level) = link;
+      link = added;
+   }
+   added->prev = path[0];
+   if (added->next != nullptr)
+   {
+      added->next->prev = added;
    }
    else
    {
-      tail->next = new node (pair);
-      tail->next->prev = tail;
-      tail = tail->next;
+      tail = added;
    }
 }
 
-template <typename Key, typename Value, class Less>
-typename listmap<Key,Value,Less>::iterator
-listmap<Key,Value,Less>::find (const key_type& that)// const {
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::find (
+            const key_type& that)
+            // const {
+{
+   TRACE ('l', that);
+   return iterator (this, find_node (that));
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup, typename L, typename>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::find (
+            const Lookup& that)
 {
    TRACE ('l', that);
-   node *itor = head;
-   for (; itor != nullptr; itor = itor->next)
+   return iterator (this, find_node (that));
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node*
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::find_node (
+            const Lookup& that)
+{
+   if (Hash::indexes) return index_find (that, hasher (that));
+   node *path[max_height];
+   node *found = find_path (that, path);
+   if (found != nullptr && !less (that, found->pair.first))
+   {
+      return found;
+   }
+   return nullptr;
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup>
+bool
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::equal (
+            const key_type& left, const Lookup& right) const
+{
+   return !less (left, right) && !less (right, left);
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::node*
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::index_find (
+            const Lookup& key, size_t hash) const
+{
+   if (buckets.empty()) return nullptr;
+   node *found = buckets[hash & (buckets.size() - 1)];
+   while (found != nullptr
+          && (found->hash != hash || !equal (found->pair.first, key)))
    {
-      if (!less (that, (itor->pair).first) &&
-         !less ((itor->pair).first, that))
+      found = found->chain;
+   }
+   return found;
+}
+
+// Doubles the buckets once there are as many nodes as buckets.
+// The nodes keep their hashes, so no key is hashed again.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::index_add (node* added)
+{
+   if (indexed >= buckets.size())
+   {
+      vector<node*> grown (buckets.empty() ? 16 : 2 * buckets.size(),
+                           nullptr);
+      size_t mask = grown.size() - 1;
+      for (node *chain: buckets)
+      {
+         while (chain != nullptr)
+         {
+            node *next = chain->chain;
+            chain->chain = grown[chain->hash & mask];
+            grown[chain->hash & mask] = chain;
+            chain = next;
+         }
+      }
+      buckets.swap (grown);
+   }
+   node*& bucket = buckets[added->hash & (buckets.size() - 1)];
+   added->chain = bucket;
+   bucket = added;
+   ++indexed;
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::index_remove (node* where)
+{
+   node **link = &buckets[where->hash & (buckets.size() - 1)];
+   while (*link != where) link = &(*link)->chain;
+   *link = where->chain;
+   --indexed;
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::value_add (
+            node* added)
+{
+   values[value_hasher (added->pair.second)].insert (added);
+}
+
+// Also called for a node that value_add failed to add.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::value_remove (
+            node* where)
+{
+   auto group = values.find (value_hasher (where->pair.second));
+   if (group == values.end()) return;
+   group->second.erase (where);
+   if (group->second.empty()) values.erase (group);
+}
+
+// Moves found to the group of its new value, if that differs.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Mapped>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::replace_value (
+            node* found, Mapped&& value)
+{
+   if (!ValueHash::indexes)
+   {
+      found->pair.second = std::forward<Mapped> (value);
+      return;
+   }
+   if (found->pair.second == value) return;
+   value_remove (found);
+   found->pair.second = std::forward<Mapped> (value);
+   value_add (found);
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup>
+bool listmap<Key,Value,Less,Alloc,Hash,ValueHash>::same_value (
+            const mapped_type& left, const Lookup& right)
+{
+   return !(left < right) && !(right < left);
+}
+
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+vector<typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator>
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::find_value (
+            const mapped_type& value)
+{
+   return find_value<mapped_type> (value);
+}
+
+// A group may hold other values with the same hash, so each node
+// in it is compared with value too.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Lookup>
+vector<typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator>
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::find_value (
+            const Lookup& value)
+{
+   TRACE ('l', value);
+   vector<iterator> result;
+   if (ValueHash::indexes)
+   {
+      auto group = values.find (value_hasher (value));
+      if (group == values.end()) return result;
+      for (node *found: group->second)
+      {
+         if (same_value (found->pair.second, value))
+         {
+            result.push_back (iterator (this, found));
+         }
+      }
+      return result;
+   }
+   for (node *where = head; where != nullptr; where = where->next)
+   {
+      if (same_value (where->pair.second, value))
       {
-         return iterator (this, itor);
+         result.push_back (iterator (this, where));
       }
    }
-   return iterator();
+   return result;
+}
+
+// Takes where out of every level it is on, and out of the indexes,
+// without freeing it.  A node only on level 0 needs no search.
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::unlink (node* where)
+{
+   if (Hash::indexes) index_remove (where);
+   if (ValueHash::indexes) value_remove (where);
+   node *path[max_height];
+   if (where->height == 1) path[0] = where->prev;
+   else find_path (where->pair.first, path);
+   for (int level = 0; level < where->height; ++level)
+   {
+      forward (path[level], level) = forward (where, level);
+   }
+   if (where->next != nullptr)
+   {
+      where->next->prev = where->prev;
+   }
+   else
+   {
+      tail = where->prev;
+   }
+   while (height > 1 && skip_heads[height - 2] == nullptr) --height;
 }
 
-template <typename Key, typename Value, class Less>
-typename listmap<Key,Value,Less>::iterator
-listmap<Key,Value,Less>::begin () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::begin () 
 {
    return iterator (this, head);
 }
 
-template <typename Key, typename Value, class Less>
-typename listmap<Key,Value,Less>::iterator
-listmap<Key,Value,Less>::end () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::end () 
 {
    return iterator (this, nullptr);
 }
 
-template <typename Key, typename Value, class Less>
-bool listmap<Key,Value,Less>::empty () const 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+bool listmap<Key,Value,Less,Alloc,Hash,ValueHash>::empty () const 
 {
    return head == nullptr;
 }
 
 
-template <typename Key, typename Value, class Less>
-xpair<Key,Value>& listmap<Key,Value,Less>::iterator::operator* () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterated_type&
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::operator* () 
 {
    TRACE ('l', where->pair);
    return where->pair;
 }
 
-template <typename Key, typename Value, class Less>
-xpair<Key,Value> *listmap<Key,Value,Less>::iterator::operator-> () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterated_type*
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::operator-> () 
 {
    TRACE ('l', where->pair);
    return &(where->pair);
 }
 
-template <typename Key, typename Value, class Less>
-typename listmap<Key,Value,Less>::iterator&
-listmap<Key,Value,Less>::iterator::operator++ () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator&
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::operator++ () 
 {
    TRACE ('l', "First: " << map << ", " << where);
    TRACE ('l', "Second: " << map->head << ", " << map->tail);
@@ -143,52 +497,50 @@ listmap<Key,Value,Less>::iterator::operator++ ()
    return *this;
 }
 
-template <typename Key, typename Value, class Less>
-typename listmap<Key,Value,Less>::iterator&
-listmap<Key,Value,Less>::iterator::operator-- () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+typename listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator&
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::operator-- () 
 {
    if (where == nullptr) return *this;
    where = where->prev;
    return *this;
 }
 
-template <typename Key, typename Value, class Less>
-bool listmap<Key,Value,Less>::iterator::operator==
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+bool listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::operator==
             (const iterator& that) const 
 {
    return this->where == that.where;
 }
 
-template <typename Key, typename Value, class Less>
-listmap<Key,Value,Less>::iterator::iterator (listmap *map,
-            node *where): map (map), where (where)
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::iterator (
+            listmap *map, node *where): map (map), where (where)
 {
    
 }
 
-template <typename Key, typename Value, class Less>
-void listmap<Key,Value,Less>::iterator::erase () 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::erase () 
 {
    TRACE ('l', "map = " << map << ", where = " << where << endl);
    if (where == nullptr) return;
-   if (where->prev != nullptr)
-   {
-      where->prev->next = where->next;
-   }
-   else
-   {
-      map->head = where->next;
-   }
-   if (where->next != nullptr)
-   {
-      where->next->prev = where->prev;
-   }
-   else
-   {
-      map->tail = where->prev;
-   }
+   map->unlink (where);
    node *tmp = where->next;
-   delete where;
+   map->delete_node (where);
    where = tmp;
 }
 
+template <typename Key, typename Value, class Less, class Alloc,
+          class Hash, class ValueHash>
+template <typename Mapped>
+void listmap<Key,Value,Less,Alloc,Hash,ValueHash>::iterator::set_value
+            (Mapped&& value)
+{
+   TRACE ('l', "map = " << map << ", where = " << where << endl);
+   map->replace_value (where, std::forward<Mapped> (value));
+}
@@ -0,0 +1,97 @@
+// Author: Coy Humphrey (cmhumphr)
+
+//
+// listtest -
+//    Checks that the value index follows every change of value:
+//    by insert, by set_value through an iterator, and by erase,
+//    looking values up both as strings and as tokens.  With the
+//    index on, a pair must be read-only through an iterator.
+//    Prints each check that fails, and exits 1 if any did.
+//
+//    Not part of keyvalue;  built and run by "make test".
+//
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+#include "listmap.h"
+
+typedef listmap<string,string,xless<string>,node_pool,
+                xhash<string>,xhash<string>> value_map;
+typedef listmap<string,string> plain_map;
+
+static_assert (is_const<remove_reference<
+                  decltype (*value_map().begin())>::type>::value,
+               "a pair must be read-only when values are indexed");
+static_assert (not is_const<remove_reference<
+                  decltype (*plain_map().begin())>::type>::value,
+               "a pair may be changed when values are not indexed");
+
+static int failures = 0;
+
+// The keys of the pairs found with value, as "key key ...".
+template <typename map_t, typename lookup_t>
+static string keys_of (map_t& map, const lookup_t& value)
+{
+   string keys;
+   for (auto itor: map.find_value (value))
+   {
+      if (not keys.empty()) keys += ' ';
+      keys += itor->first;
+   }
+   return keys;
+}
+
+template <typename map_t>
+static void check (map_t& map, const char* value, const string& keys)
+{
+   string as_string = keys_of (map, string (value));
+   string as_token = keys_of (map, token {value, strlen (value)});
+   if (as_string == keys and as_token == keys) return;
+   cout << "find_value " << value << ": expected \"" << keys
+        << "\", got \"" << as_string << "\" and \"" << as_token
+        << "\"" << endl;
+   ++failures;
+}
+
+template <typename map_t>
+static void run()
+{
+   map_t map;
+   map.insert (typename map_t::value_type ("a", "one"));
+   map.insert (typename map_t::value_type ("b", "two"));
+   map.insert (typename map_t::value_type ("c", "one"));
+   check (map, "one", "a c");
+   check (map, "two", "b");
+
+   auto itor = map.find ("a");
+   itor.set_value ("two");
+   check (map, "one", "c");
+   check (map, "two", "a b");
+
+   itor = map.find ("c");
+   itor.set_value (string ("three"));
+   check (map, "one", "");
+   check (map, "three", "c");
+
+   map.insert (typename map_t::value_type ("b", "three"));
+   check (map, "two", "a");
+   check (map, "three", "b c");
+
+   map.find ("b").erase();
+   check (map, "three", "c");
+}
+
+int main()
+{
+   run<value_map>();
+   run<plain_map>();
+   cout << (failures == 0 ? "listtest: ok" : "listtest: FAILED")
+        << endl;
+   return failures == 0 ? 0 : 1;
+}
@@ -1,6 +1,7 @@
 // Author: Coy Humphrey (cmhumphr)
 
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <fstream>
@@ -14,7 +15,8 @@ using namespace std;
 #include "util.h"
 
 typedef xpair<string,string> str_str_pair;
-typedef listmap<string,string> str_str_map;
+typedef listmap<string,string,xless<string>,node_pool,
+                xhash<string>,xhash<string>> str_str_map;
 
 void scan_options (int argc, char** argv) {
    opterr = 0;
@@ -33,11 +35,11 @@ void scan_options (int argc, char** argv) {
    }
 }
 
-string trim (const string &str) {
-   size_t first = str.find_first_not_of (" \t");
-   if (first == string::npos) return "";
-   size_t last = str.find_last_not_of (" \t");
-   return str.substr (first, last - first + 1);
+// The text without leading and trailing blanks, in the same place.
+token trim (const char* begin, const char* end) {
+   while (begin != end && (*begin == ' ' || *begin == '\t')) ++begin;
+   while (end != begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+   return {begin, size_t (end - begin)};
 }
 
 void scan_file (istream &in, string fname, str_str_map &map)
@@ -48,28 +50,32 @@ void scan_file (istream &in, string fname, str_str_map &map)
       getline (in, line);
       if (in.eof()) break;
       cout << fname << ": " << lnum << ": " << line << endl;
-      line = trim (line);
-      if (line.size() == 0 || line[0] == '#') continue;
-      size_t pos = line.find_first_of ("=");
-      if (pos == string::npos)
+      // key, value and the rest point into line, rather than being
+      // copies of parts of it.
+      token text = trim (line.data(), line.data() + line.size());
+      if (text.size == 0 || text.data[0] == '#') continue;
+      const char* text_end = text.data + text.size;
+      const char* equals = static_cast<const char*>
+            (memchr (text.data, '=', text.size));
+      if (equals == nullptr)
       {
          //cout << "key only: " << line << endl;
          // Print key and value pair
-         auto itor = map.find (line);
+         auto itor = map.find (text);
          if (itor == map.end())
          {
-            complain() << line << ": Key not found" << endl;
+            complain() << text << ": Key not found" << endl;
             continue;
          }
          cout << (*itor).first << " = " << (*itor).second << endl;
       }
       else
       {
-         string key = trim (line.substr (0, pos));
-         string value = trim (line.substr (pos + 1));
+         token key = trim (text.data, equals);
+         token value = trim (equals + 1, text_end);
          //cout << "key is: " << key << endl;
          //cout << "val is: " << value << endl;
-         if (key.empty() && value.empty())
+         if (key.size == 0 && value.size == 0)
          {
             //cout << "only =" << endl;
             // Print values of map
@@ -78,31 +84,29 @@ void scan_file (istream &in, string fname, str_str_map &map)
                cout << (*itor).first << " = " << (*itor).second << endl;
             }
          }
-         else if (value.empty())
+         else if (value.size == 0)
          {
             //cout << "key =" << endl;
             // Delete key from map
             auto itor = map.find (key);
             itor.erase();
          }
-         else if (key.empty())
+         else if (key.size == 0)
          {
             //cout << "= value" << endl;
             // Print all pairs with value
-            for (auto itor = map.begin(); itor != map.end(); ++itor)
+            for (auto itor: map.find_value (value))
             {
-               if ((*itor).second == value)
-               {
-                  cout << (*itor).first << " = " 
-                     << (*itor).second << endl;
-               }
+               cout << (*itor).first << " = " 
+                  << (*itor).second << endl;
             }
          }
          else
          {
             cout << key << " = " << value << endl;
-            // Set key and value pair
-            map.insert (xpair<string,string> (key, value));
+            // Set key and value pair, each copied once, from line
+            // to where the map keeps it
+            map.emplace (key.str(), value.str());
          }
       }
    }
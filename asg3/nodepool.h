@@ -0,0 +1,95 @@
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __NODEPOOL_H__
+#define __NODEPOOL_H__
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+//
+// Allocation policies for listmap's nodes.  A policy has
+//    void* allocate (size_t bytes);
+//    void deallocate (void* where, size_t bytes);
+//    static const bool frees_all;
+// where frees_all says the policy's destructor gives back
+// everything it handed out, so a map going away need not
+// deallocate its nodes one at a time.
+//
+// node_pool -
+//    Carves nodes out of 64K slabs.  Sizes are rounded up to a
+//    multiple of 16, and each size has its own free list, so the
+//    node an erase gives back is the next one handed out.  Slabs
+//    are only freed, all at once, when the pool goes.  A block
+//    too big to share a slab gets a slab of its own.  Not thread
+//    safe.
+// node_heap -
+//    new and delete for every node.
+//
+
+class node_pool {
+   private:
+      node_pool (const node_pool&) = delete;
+      node_pool& operator= (const node_pool&) = delete;
+      static const size_t granule = 16;
+      static const size_t slab_bytes = 64 << 10;
+      struct free_block {
+         free_block* next;
+      };
+      vector<free_block*> free_lists;
+      vector<char*> slabs;
+      char* bump;
+      size_t bump_left;
+   public:
+      static const bool frees_all = true;
+      node_pool(): bump (nullptr), bump_left (0) {}
+      ~node_pool() {
+         for (char* slab: slabs) ::operator delete (slab);
+      }
+      void* allocate (size_t bytes) {
+         size_t index = (bytes - 1) / granule;
+         if (index >= free_lists.size())
+            free_lists.resize (index + 1, nullptr);
+         free_block*& list = free_lists[index];
+         if (list != nullptr)
+         {
+            free_block* result = list;
+            list = list->next;
+            return result;
+         }
+         size_t rounded = (index + 1) * granule;
+         if (rounded > slab_bytes / 4)
+         {
+            char* own = static_cast<char*> (::operator new (rounded));
+            slabs.push_back (own);
+            return own;
+         }
+         if (bump_left < rounded)
+         {
+            bump = static_cast<char*> (::operator new (slab_bytes));
+            slabs.push_back (bump);
+            bump_left = slab_bytes;
+         }
+         void* result = bump;
+         bump += rounded;
+         bump_left -= rounded;
+         return result;
+      }
+      void deallocate (void* where, size_t bytes) {
+         free_block* freed = static_cast<free_block*> (where);
+         free_block*& list = free_lists[(bytes - 1) / granule];
+         freed->next = list;
+         list = freed;
+      }
+};
+
+struct node_heap {
+   static const bool frees_all = false;
+   void* allocate (size_t bytes) { return ::operator new (bytes); }
+   void deallocate (void* where, size_t) { ::operator delete (where); }
+};
+
+#endif
+
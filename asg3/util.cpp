@@ -8,6 +8,7 @@
 #include <string>
 using namespace std;
 
+#include "../common/tokenize.h"
 #include "util.h"
 
 int sys_info::exit_status = EXIT_SUCCESS;
@@ -54,14 +55,10 @@ const string datestring () {
 
 list<string> split (const string& line, const string& delimiters) {
    list<string> words;
-   size_t end = 0;
-   // Loop over the string, splitting out words, and for each word
-   // thus found, append it to the output list<string>.
-   for (;;) {
-      size_t start = line.find_first_not_of (delimiters, end);
-      if (start == string::npos) break;
-      end = line.find_first_of (delimiters, start);
-      words.push_back (line.substr (start, end - start));
+   delimiter_set delimiter_table (delimiters);
+   tokenizer tokens (line, delimiter_table);
+   for (token word; tokens.next (word); ) {
+      words.emplace_back (word.data, word.size);
    }
    TRACE ('u', words);
    return words;
@@ -0,0 +1,66 @@
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __XHASH_H__
+#define __XHASH_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+#include "../common/tokenize.h"
+
+//
+// Hash policies for listmap.  indexes says whether the map keeps a
+// hash index of its keys at all.  A hash must give equal keys, in
+// the sense of the map's Less, equal values.
+//
+// xhash -
+//    Indexes keys with std::hash.  For strings it hashes the bytes
+//    itself (64-bit FNV-1a), so that a token hashes the same as the
+//    string with the same bytes, and can be looked up as it is.
+// no_hash -
+//    No index;  every lookup goes through the ordered list.
+//
+
+template <typename Type>
+struct xhash {
+   static const bool indexes = true;
+   size_t operator() (const Type& key) const {
+      return hash<Type>() (key);
+   }
+};
+
+template <>
+struct xhash<string> {
+   static const bool indexes = true;
+   static size_t hash_bytes (const char* bytes, size_t size) {
+      uint64_t result = 14695981039346656037u;
+      for (const char* end = bytes + size; bytes != end; ++bytes)
+      {
+         result = (result ^ (unsigned char) *bytes) * 1099511628211u;
+      }
+      // The buckets are picked by the low bits, which FNV mixes least.
+      return result ^ (result >> 32);
+   }
+   size_t operator() (const string& key) const {
+      return hash_bytes (key.data(), key.size());
+   }
+   size_t operator() (const token& key) const {
+      return hash_bytes (key.data, key.size);
+   }
+};
+
+template <typename Type>
+struct no_hash {
+   static const bool indexes = false;
+   template <typename Any>
+   size_t operator() (const Any&) const {
+      return 0;
+   }
+};
+
+#endif
+
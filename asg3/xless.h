@@ -6,12 +6,22 @@
 //
 // We assume that the type type_t has an operator< function.
 //
+// xless is transparent:  it also compares a Type with anything
+// that has an operator< with Type both ways round, such as a
+// string with a token, so a map can be searched without first
+// making a key.
+//
 
 template <typename Type>
 struct xless {
+   typedef void is_transparent;
    bool operator() (const Type& left, const Type& right) const {
       return left < right;
    }
+   template <typename Left, typename Right>
+   bool operator() (const Left& left, const Right& right) const {
+      return left < right;
+   }
 };
 
 #endif
@@ -4,6 +4,7 @@
 #define __XPAIR_H__
 
 #include <iostream>
+#include <utility>
 
 using namespace std;
 
@@ -12,9 +13,13 @@ using namespace std;
 //
 // The implicitly generated members will work, because they just
 // send messages to the first and second fields, respectively.
+// That includes the move constructor and move assignment.
 // Caution:  xpair() does not initialize its fields unless
 // First and Second do so with their default ctors.
 //
+// The two-argument template constructor passes on whatever it is
+// given, so an rvalue is moved into the field rather than copied.
+//
 
 template <typename First, typename Second>
 struct xpair {
@@ -23,6 +28,10 @@ struct xpair {
    xpair(): first(First()), second(Second()) {}
    xpair (const First& first, const Second& second):
                first(first), second(second) {}
+   template <typename Key, typename Value>
+   xpair (Key&& first, Value&& second):
+               first(std::forward<Key> (first)),
+               second(std::forward<Value> (second)) {}
 };
 
 template <typename First, typename Second>
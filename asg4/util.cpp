@@ -10,6 +10,7 @@
 #include <typeinfo>
 using namespace std;
 
+#include "../common/tokenize.h"
 #include "util.h"
 
 int sys_info::exit_status_ = EXIT_SUCCESS;
@@ -56,12 +57,10 @@ const string datestring() {
 
 vector<string> split (const string& line, const string& delimiters) {
    vector<string> words;
-   int end = 0;
-   for (;;) {
-      size_t start = line.find_first_not_of (delimiters, end);
-      if (start == string::npos) break;
-      end = line.find_first_of (delimiters, start);
-      words.push_back (line.substr (start, end - start));
+   delimiter_set delimiter_table (delimiters);
+   tokenizer tokens (line, delimiter_table);
+   for (token word; tokens.next (word); ) {
+      words.emplace_back (word.data, word.size);
    }
    DEBUGF ('u', words);
    return words;
@@ -12,6 +12,7 @@ using namespace std;
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "../common/tokenize.h"
 #include "cix_protocol.h"
 #include "logstream.h"
 #include "signal_action.h"
@@ -245,12 +246,10 @@ void signal_handler (int signal) {
 
 vector<string> split (const string& line, const string& delimiters) {
    vector<string> words;
-   int end = 0;
-   for (;;) {
-      size_t start = line.find_first_not_of (delimiters, end);
-      if (start == string::npos) break;
-      end = line.find_first_of (delimiters, start);
-      words.push_back (line.substr (start, end - start));
+   delimiter_set delimiter_table (delimiters);
+   tokenizer tokens (line, delimiter_table);
+   for (token word; tokens.next (word); ) {
+      words.emplace_back (word.data, word.size);
    }
    return words;
 }
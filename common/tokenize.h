@@ -0,0 +1,152 @@
+// $Id: tokenize.h,v 1.1 2014-04-09 17:04:58-07 - - $
+// Author: Coy Humphrey (cmhumphr)
+
+#ifndef __TOKENIZE_H__
+#define __TOKENIZE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//
+// Splitting lines into words without copying them, shared by the
+// split() of each program.  Header only;  include it as
+// "../common/tokenize.h".
+//
+// token -
+//    A word found by a tokenizer:  a pointer into the line and a
+//    length, valid as long as the line is.  (std::string_view,
+//    for code built as C++11.)  Compares with std::string, so a
+//    map with a transparent comparator can look it up as it is.
+// delimiter_set -
+//    The delimiters as a 256-bit table, one bit per byte value, so
+//    testing a byte is a shift and a mask however many delimiters
+//    there are.  Sets of at most four bytes, such as " \t" or "/",
+//    are also kept as a list, for the SSE2 scan.
+// tokenizer -
+//    Hands out the words of [begin, end) one at a time.  With a
+//    small delimiter set and SSE2, each scan looks at 16 bytes at
+//    a time:  compare the block against each delimiter, take the
+//    mask of matching bytes, and the first set bit (or clear bit,
+//    when skipping delimiters) is where the word starts or ends.
+//    Otherwise it steps byte by byte through the table.
+//
+
+struct token {
+   const char* data;
+   size_t size;
+   std::string str() const { return std::string (data, size); }
+   bool operator== (const char* text) const {
+      return std::strlen (text) == size
+             and std::memcmp (data, text, size) == 0;
+   }
+};
+
+inline bool operator< (const token& left, const std::string& right) {
+   return right.compare (0, right.size(), left.data, left.size) > 0;
+}
+
+inline bool operator< (const std::string& left, const token& right) {
+   return left.compare (0, left.size(), right.data, right.size) < 0;
+}
+
+inline std::ostream& operator<< (std::ostream& out, const token& word) {
+   return out.write (word.data, word.size);
+}
+
+class delimiter_set {
+   private:
+      uint64_t bits[4] {0, 0, 0, 0};
+      char small[4] {0, 0, 0, 0};
+      int small_count {0};
+   public:
+      explicit delimiter_set (const char* delimiters) {
+         for (; *delimiters != '\0'; ++delimiters)
+         {
+            unsigned char byte = *delimiters;
+            if (contains (byte)) continue;
+            bits[byte >> 6] |= uint64_t (1) << (byte & 63);
+            if (small_count <= 4)
+            {
+               if (small_count < 4) small[small_count] = byte;
+               ++small_count;
+            }
+         }
+      }
+      explicit delimiter_set (const std::string& delimiters):
+         delimiter_set (delimiters.c_str()) {}
+      bool contains (unsigned char byte) const {
+         return bits[byte >> 6] >> (byte & 63) & 1;
+      }
+      friend class tokenizer;
+};
+
+class tokenizer {
+   private:
+      const char* pos;
+      const char* end;
+      const delimiter_set& delimiters;
+#ifdef __SSE2__
+      // Bit n set if byte n of the block is a delimiter.
+      unsigned block_mask (const char* block) const {
+         __m128i bytes = _mm_loadu_si128 (
+               reinterpret_cast<const __m128i*> (block));
+         __m128i hits = _mm_setzero_si128();
+         for (int nr = 0; nr < delimiters.small_count; ++nr)
+         {
+            hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (bytes,
+                                 _mm_set1_epi8 (delimiters.small[nr])));
+         }
+         return _mm_movemask_epi8 (hits);
+      }
+#endif
+      // The first byte from from on that is (or is not) a delimiter.
+      const char* scan (const char* from, bool want_delimiter) const {
+#ifdef __SSE2__
+         if (delimiters.small_count <= 4)
+         {
+            for (; end - from >= 16; from += 16)
+            {
+               unsigned mask = block_mask (from);
+               if (not want_delimiter) mask = ~mask & 0xFFFF;
+               if (mask != 0) return from + __builtin_ctz (mask);
+            }
+         }
+#endif
+         while (from < end
+                and delimiters.contains (*from) != want_delimiter)
+            ++from;
+         return from;
+      }
+   public:
+      tokenizer (const char* begin, const char* end,
+                 const delimiter_set& delimiters):
+         pos (begin), end (end), delimiters (delimiters) {}
+      tokenizer (const std::string& line,
+                 const delimiter_set& delimiters):
+         tokenizer (line.data(), line.data() + line.size(),
+                    delimiters) {}
+      // Sets word to the next word and returns true, or returns
+      // false if there are no more.
+      bool next (token& word) {
+         const char* start = scan (pos, false);
+         if (start == end)
+         {
+            pos = end;
+            return false;
+         }
+         pos = scan (start, true);
+         word.data = start;
+         word.size = pos - start;
+         return true;
+      }
+};
+
+#endif
+